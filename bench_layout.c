@@ -0,0 +1,152 @@
+// bench_layout.c
+// Measures false sharing in struct Dungeon during a rogue round: one thread stores to
+// rogue.pick in a tight loop (the rogue) while another keeps reading running, enemy.health and
+// barbarian.attack (the dungeon / barbarian side). Built twice by the makefile, once per layout.
+#define _GNU_SOURCE // pthread_setaffinity_np(), syscall()
+
+#include <stdio.h> // printf()
+#include <stdlib.h> // exit codes
+#include <string.h> // memset()
+#include <pthread.h> // threads
+#include <sched.h> // cpu sets
+#include <unistd.h> // syscall()
+#include <sys/ioctl.h> // perf ioctls
+#include <sys/mman.h> // shared mapping
+#include <sys/syscall.h> // SYS_perf_event_open, SYS_gettid
+#include <linux/perf_event.h> // perf counter types
+
+#include "dungeon_info.h" // the layout under test
+#include "dungeon_clock.h" // dungeon_now_ns()
+#include "dungeon_atomic.h" // the accessors the roles use
+
+#ifdef DUNGEON_PARTITIONED_LAYOUT
+#define LAYOUT_NAME "partitioned"
+#else
+#define LAYOUT_NAME "packed"
+#endif
+
+#define BENCH_SECONDS (1)
+
+static struct Dungeon *g_dungeon = NULL;
+static _Atomic int g_stop = 0;
+static _Atomic int g_reader_tid = 0;
+
+static void pin_to(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set); // best effort
+}
+
+// the rogue: store a new pick as fast as possible
+static void *writer(void *arg) {
+    pin_to(*(int *)arg);
+    float p = 0.0f;
+    while (!atomic_load_explicit(&g_stop, memory_order_relaxed)) {
+        dungeon_store_pick(g_dungeon, p);
+        p += 1.0f;
+    }
+    return NULL;
+}
+
+// the dungeon/barbarian side: keep reading the fields it owns or waits on
+static void *reader(void *arg) {
+    pin_to(*(int *)arg);
+    atomic_store(&g_reader_tid, (int)syscall(SYS_gettid));
+
+    unsigned long long loads = 0;
+    int sink = 0;
+    while (!atomic_load_explicit(&g_stop, memory_order_relaxed)) {
+        sink += dungeon_running(g_dungeon) + dungeon_load_health(g_dungeon) + dungeon_load_attack(g_dungeon);
+        loads += 3;
+    }
+    (void)sink;
+    return (void *)(uintptr_t)loads;
+}
+
+static int open_counter(int tid, unsigned type, unsigned long long config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0);
+}
+
+static long long read_counter(int fd) {
+    long long value = -1;
+    if (fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value)) return -1;
+    return value;
+}
+
+int main(void) {
+    g_dungeon = mmap(NULL, sizeof(struct Dungeon), PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS, -1, 0); // same kind of mapping the roles use
+    if (g_dungeon == MAP_FAILED) {
+        perror("bench_layout mmap");
+        return EXIT_FAILURE;
+    }
+    memset(g_dungeon, 0, sizeof(*g_dungeon));
+    dungeon_set_running(g_dungeon, true);
+
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int writer_cpu = 0;
+    int reader_cpu = ncpu > 1 ? 1 : 0;
+
+    pthread_t w, r;
+    pthread_create(&r, NULL, reader, &reader_cpu);
+    while (atomic_load(&g_reader_tid) == 0) {
+        sched_yield();
+    }
+    int tid = atomic_load(&g_reader_tid);
+
+    // misses seen by the reader: with false sharing every pick store steals its line
+    int l1d_fd = open_counter(tid, PERF_TYPE_HW_CACHE,
+                              PERF_COUNT_HW_CACHE_L1D
+                              | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                              | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    int miss_fd = open_counter(tid, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+
+    pthread_create(&w, NULL, writer, &writer_cpu);
+    if (l1d_fd >= 0) ioctl(l1d_fd, PERF_EVENT_IOC_ENABLE, 0);
+    if (miss_fd >= 0) ioctl(miss_fd, PERF_EVENT_IOC_ENABLE, 0);
+
+    uint64_t start = dungeon_now_ns();
+    sleep(BENCH_SECONDS);
+    atomic_store(&g_stop, 1);
+
+    void *ret = NULL;
+    pthread_join(w, NULL);
+    pthread_join(r, &ret);
+    double secs = (double)(dungeon_now_ns() - start) / 1e9;
+    unsigned long long loads = (unsigned long long)(uintptr_t)ret;
+
+    long long l1d = read_counter(l1d_fd);
+    long long misses = read_counter(miss_fd);
+
+    printf("{\"layout\": \"%s\", \"sizeof_dungeon\": %zu, \"rogue_line\": %zu, \"barbarian_line\": %zu, "
+           "\"cpus\": [%d, %d], \"reader_loads_per_sec\": %.0f",
+           LAYOUT_NAME, sizeof(struct Dungeon),
+           offsetof(struct Dungeon, rogue) / DUNGEON_CACHE_LINE,
+           offsetof(struct Dungeon, barbarian) / DUNGEON_CACHE_LINE,
+           writer_cpu, reader_cpu, (double)loads / secs);
+    if (l1d >= 0) {
+        printf(", \"reader_l1d_misses_per_1k_loads\": %.2f", (double)l1d * 1000.0 / (double)loads);
+    } else {
+        printf(", \"reader_l1d_misses_per_1k_loads\": null"); // no perf access here
+    }
+    if (misses >= 0) {
+        printf(", \"reader_cache_misses\": %lld", misses);
+    } else {
+        printf(", \"reader_cache_misses\": null");
+    }
+    printf("}\n");
+
+    if (l1d_fd >= 0) close(l1d_fd);
+    if (miss_fd >= 0) close(miss_fd);
+    munmap(g_dungeon, sizeof(*g_dungeon));
+    return EXIT_SUCCESS;
+}
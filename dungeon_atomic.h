@@ -0,0 +1,162 @@
+#ifndef DUNGEON_ATOMIC_H
+#define DUNGEON_ATOMIC_H
+//Typed accessors for the fields of struct Dungeon that more than one process touches.
+//Scalars are loaded with acquire and stored with release, which on x86 and ARM64 are plain
+//loads and stores (ldar/stlr on ARM64), so the rogue's pick loop pays no lock per tick.
+//Multi-byte fields (barrier.spell, treasure) are read as a snapshot under a seqlock:
+//  writer: dungeon_seq_write_begin(), write the bytes, dungeon_seq_write_end()
+//  reader: dungeon_seq_read() retries until it copied the bytes between two equal, even counts
+//The prebuilt RunDungeon() writes those fields without bumping the counter; while a counter is
+//still 0 the reader instead copies until two reads in a row agree.
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "dungeon_info.h"
+
+//The struct is shared between processes, so the atomics must not be backed by a lock table.
+_Static_assert(ATOMIC_BOOL_LOCK_FREE == 2 && ATOMIC_CHAR_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+               "struct Dungeon atomics must be lock-free");
+
+//Give up on a snapshot after this many retries (a writer that died mid-write leaves the count odd).
+#define DUNGEON_SEQ_MAX_TRIES (100000)
+
+static inline bool dungeon_running(const struct Dungeon *d){
+	return atomic_load_explicit(&d->running, memory_order_acquire);
+}
+static inline void dungeon_set_running(struct Dungeon *d, bool running){
+	atomic_store_explicit(&d->running, running, memory_order_release);
+}
+
+static inline int dungeon_load_health(const struct Dungeon *d){
+	return atomic_load_explicit(&d->enemy.health, memory_order_acquire);
+}
+static inline void dungeon_store_health(struct Dungeon *d, int health){
+	atomic_store_explicit(&d->enemy.health, health, memory_order_release);
+}
+
+static inline int dungeon_load_attack(const struct Dungeon *d){
+	return atomic_load_explicit(&d->barbarian.attack, memory_order_acquire);
+}
+static inline void dungeon_store_attack(struct Dungeon *d, int attack){
+	atomic_store_explicit(&d->barbarian.attack, attack, memory_order_release);
+}
+
+static inline float dungeon_load_pick(const struct Dungeon *d){
+	return atomic_load_explicit(&d->rogue.pick, memory_order_acquire);
+}
+static inline void dungeon_store_pick(struct Dungeon *d, float pick){
+	atomic_store_explicit(&d->rogue.pick, pick, memory_order_release);
+}
+
+static inline char dungeon_load_direction(const struct Dungeon *d){
+	return atomic_load_explicit(&d->trap.direction, memory_order_acquire);
+}
+//Release: a pick stored before this is visible to whoever sees the new direction.
+static inline void dungeon_store_direction(struct Dungeon *d, char direction){
+	atomic_store_explicit(&d->trap.direction, direction, memory_order_release);
+}
+
+static inline bool dungeon_trap_locked(const struct Dungeon *d){
+	return atomic_load_explicit(&d->trap.locked, memory_order_acquire);
+}
+static inline void dungeon_set_trap_locked(struct Dungeon *d, bool locked){
+	atomic_store_explicit(&d->trap.locked, locked, memory_order_release);
+}
+
+//Seqlock writer side. Only one writer per counter.
+static inline void dungeon_seq_write_begin(_Atomic uint32_t *seq){
+	uint32_t s = atomic_load_explicit(seq, memory_order_relaxed);
+	atomic_store_explicit(seq, s + 1, memory_order_relaxed); //odd: write in progress
+	atomic_thread_fence(memory_order_release); //counter lands before any of the bytes
+}
+static inline void dungeon_seq_write_end(_Atomic uint32_t *seq){
+	atomic_fetch_add_explicit(seq, 1, memory_order_release); //even again, bytes land first
+}
+
+//Copy n bytes out of shared memory. volatile keeps the compiler from merging or caching the reads.
+static inline void dungeon_seq_copy(char *dst, const volatile char *src, size_t n){
+	for (size_t i = 0; i < n; ++i) {
+		dst[i] = src[i];
+	}
+}
+
+//Snapshot n bytes guarded by seq into dst. Returns false if no consistent copy was seen in
+//DUNGEON_SEQ_MAX_TRIES attempts; dst then holds the last copy.
+static inline bool dungeon_seq_read(const _Atomic uint32_t *seq, char *dst, const volatile char *src, size_t n){
+	for (int tries = 0; tries < DUNGEON_SEQ_MAX_TRIES; ++tries) {
+		uint32_t before = atomic_load_explicit(seq, memory_order_acquire);
+		if (before & 1u) continue; //writer in progress
+		dungeon_seq_copy(dst, src, n);
+		atomic_thread_fence(memory_order_acquire); //bytes are read before the counter is checked
+		if (atomic_load_explicit(seq, memory_order_relaxed) != before) continue;
+		if (before != 0) return true;
+
+		//no seqlock writer: the copy counts once a second read agrees with it
+		bool stable = true;
+		for (size_t i = 0; i < n && stable; ++i) {
+			stable = src[i] == dst[i];
+		}
+		if (stable) return true;
+	}
+	return false;
+}
+
+//Dungeon: health and its publish time under the watch generation, a seqlock like the one of
+//barrier.spell: odd while the two are written, even (and one publish further) after.
+static inline void dungeon_publish_health(struct Dungeon *d, int health, uint64_t nowNs){
+	dungeon_seq_write_begin(&d->watch.generation);
+	atomic_store_explicit(&d->enemy.health, health, memory_order_relaxed);
+	atomic_store_explicit(&d->watch.publishedNs, nowNs, memory_order_relaxed);
+	dungeon_seq_write_end(&d->watch.generation);
+}
+
+//Barbarian: the generation with the health and publish time that came with it, read like
+//dungeon_seq_read(): retried while the count is odd or moves under the reader, at most
+//DUNGEON_SEQ_MAX_TRIES times (then the last read). 0 from the prebuilt dungeon, which has no
+//generation.
+static inline uint32_t dungeon_watch_health(const struct Dungeon *d, int *health, uint64_t *publishedNs){
+	uint32_t g = 0;
+	for (int tries = 0; tries < DUNGEON_SEQ_MAX_TRIES; ++tries) {
+		g = atomic_load_explicit(&d->watch.generation, memory_order_acquire);
+		*health = atomic_load_explicit(&d->enemy.health, memory_order_relaxed);
+		*publishedNs = atomic_load_explicit(&d->watch.publishedNs, memory_order_relaxed);
+		if (g & 1u) continue; //publish in progress
+		atomic_thread_fence(memory_order_acquire); //both are read before the count is checked
+		if (atomic_load_explicit(&d->watch.generation, memory_order_relaxed) == g) break;
+	}
+	return g;
+}
+
+//Writers of the guarded fields.
+static inline void dungeon_write_barrier(struct Dungeon *d, const char *spell, size_t n){
+	volatile char *dst = d->barrier.spell;
+	if (n > sizeof(d->barrier.spell)) n = sizeof(d->barrier.spell);
+	dungeon_seq_write_begin(&d->seq.spell);
+	for (size_t i = 0; i < n; ++i) {
+		dst[i] = spell[i];
+	}
+	dungeon_seq_write_end(&d->seq.spell);
+}
+static inline void dungeon_write_treasure(struct Dungeon *d, int slot, char c){
+	dungeon_seq_write_begin(&d->seq.treasure);
+	((volatile char *)d->treasure)[slot] = c;
+	dungeon_seq_write_end(&d->seq.treasure);
+}
+
+//Readers of the guarded fields.
+static inline bool dungeon_read_barrier(const struct Dungeon *d, char out[SPELL_BUFFER_SIZE + 1]){
+	return dungeon_seq_read(&d->seq.spell, out, d->barrier.spell, sizeof(d->barrier.spell));
+}
+static inline bool dungeon_read_treasure(const struct Dungeon *d, char out[4]){
+	return dungeon_seq_read(&d->seq.treasure, out, d->treasure, sizeof(d->treasure));
+}
+
+//spoils has a single writer (the rogue) and is only judged after the room closes.
+static inline void dungeon_store_spoil(struct Dungeon *d, int slot, char c){
+	((volatile char *)d->spoils)[slot] = c;
+}
+static inline char dungeon_load_spoil(const struct Dungeon *d, int slot){
+	return ((const volatile char *)d->spoils)[slot];
+}
+#endif
@@ -0,0 +1,119 @@
+#ifndef DUNGEON_ATTACH_H
+#define DUNGEON_ATTACH_H
+//Role side of start-up: map the shared struct Dungeon and tell the launcher the role is ready.
+//The launcher passes its own descriptor for /DungeonMem in DUNGEON_SHM_FD, so a spawned role
+//maps it straight away. A role started by hand falls back to shm_open() with retries.
+//Files that include this need _DEFAULT_SOURCE (or _GNU_SOURCE).
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "dungeon_info.h"
+#include "dungeon_doorbell.h"
+#include "dungeon_atomic.h"
+#include "dungeon_clock.h"
+#include "dungeon_names.h"
+#include "dungeon_rt.h"
+#include "dungeon_segment.h" // header check, dungeon_inherited_fd()
+
+#define DUNGEON_STANDBY_ROLE_ENV "DUNGEON_STANDBY_ROLE" //set to its pid by the launcher for hot standbys
+#define DUNGEON_ATTACH_TRIES (50)        //shm_open() fallback: attempts...
+#define DUNGEON_ATTACH_RETRY_US (100000) //...and the pause between them
+#define DUNGEON_STANDBY_CHECK_MS (50)    //how often a parked standby looks for its launcher
+
+//Map the dungeon. who is used in error messages. Returns NULL on failure.
+static inline struct Dungeon *dungeon_attach(const char *who){
+	int fd = dungeon_inherited_fd();
+	for (int tries = 0; fd == -1 && tries < DUNGEON_ATTACH_TRIES; ++tries) {
+		fd = shm_open(dungeon_names()->shm, O_RDWR, 0666);
+		if (fd == -1) {
+			usleep(DUNGEON_ATTACH_RETRY_US); //game has not created it yet
+		}
+	}
+	if (fd == -1) {
+		fprintf(stderr, "%s: could not open %s. run game first.\n", who, dungeon_names()->shm);
+		return NULL;
+	}
+
+	//a launcher from before the header, or one that crashed while building: wait for a real one
+	struct DungeonHeader h;
+	const char *why = dungeon_segment_read(fd, &h);
+	for (int tries = 0; why && h.magic != DUNGEON_SEGMENT_MAGIC && tries < DUNGEON_ATTACH_TRIES; ++tries) {
+		usleep(DUNGEON_ATTACH_RETRY_US);
+		int again = shm_open(dungeon_names()->shm, O_RDWR, 0666); //the name may point to a new segment by now
+		if (again != -1) {
+			close(fd);
+			fd = again;
+		}
+		why = dungeon_segment_read(fd, &h);
+	}
+	if (why) {
+		fprintf(stderr, "%s: %s %s (built for ABI %u, %s layout); rebuild the game and its roles together.\n",
+		        who, dungeon_names()->shm, why, DUNGEON_ABI_VERSION, DUNGEON_LAYOUT ? "partitioned" : "packed");
+		close(fd);
+		return NULL;
+	}
+
+	//only the hot struct; extensions are mapped by the code that uses them
+	struct Dungeon *d = mmap(NULL, sizeof(*d), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd); //the mapping keeps the segment alive
+	if (d == MAP_FAILED) {
+		fprintf(stderr, "%s: mmap: %s\n", who, strerror(errno));
+		return NULL;
+	}
+	dungeon_rt_prefault(who, d, sizeof(*d));
+	return d;
+}
+
+//Hot standby (dungeon_supervise.h): a role started with DUNGEON_STANDBY_ROLE=<launcher pid> has
+//mapped the dungeon but sleeps here until the launcher promotes it. Returns true at once for a
+//normal role, true once promoted, false if the dungeon stops or the launcher dies first (the
+//standby was never needed).
+static inline bool dungeon_standby_wait(struct Dungeon *d, enum DungeonRole role){
+	const char *env = getenv(DUNGEON_STANDBY_ROLE_ENV);
+	if (!env || !*env) return true;
+	long launcher = strtol(env, NULL, 10);
+	unsetenv(DUNGEON_STANDBY_ROLE_ENV);
+
+	//a launcher that dies without clearing running would leave the standby asleep for good.
+	//Not PR_SET_PDEATHSIG: that fires when the spawning thread exits, and standbys after the
+	//first are spawned by the supervisor's watcher thread. getppid() only changes once the
+	//whole launcher process is gone.
+	uint32_t me = (uint32_t)getpid();
+	for (;;) {
+		uint32_t slot = atomic_load_explicit(&d->standby.promote[role], memory_order_acquire);
+		if (slot == me) return true;
+		if (!dungeon_running(d) || getppid() != (pid_t)launcher) return false;
+		struct timespec ts = { 0, DUNGEON_STANDBY_CHECK_MS * 1000000L };
+		doorbell_futex(&d->standby.promote[role], FUTEX_WAIT, slot, &ts); //slot changes on promote and stop
+	}
+}
+
+//Called once the role can take events (its runtime is open). Wakes the launcher.
+static inline void dungeon_mark_ready(struct Dungeon *d, enum DungeonRole role){
+	atomic_store_explicit(&d->ready.readyAtNs[role], dungeon_now_ns(), memory_order_relaxed);
+	atomic_fetch_add_explicit(&d->ready.count, 1, memory_order_release);
+	doorbell_futex(&d->ready.count, FUTEX_WAKE, INT_MAX, NULL);
+}
+
+//Launcher side: block until `expected` roles have called dungeon_mark_ready(), or timeoutMs
+//passes. Returns the number of ready roles.
+static inline uint32_t dungeon_wait_ready(struct Dungeon *d, uint32_t expected, int timeoutMs){
+	uint64_t deadline = dungeon_now_ns() + (uint64_t)timeoutMs * 1000000ull;
+	for (;;) {
+		uint32_t ready = atomic_load_explicit(&d->ready.count, memory_order_acquire);
+		uint64_t now = dungeon_now_ns();
+		if (ready >= expected || now >= deadline) return ready;
+		uint64_t left = deadline - now;
+		struct timespec ts = { (time_t)(left / 1000000000ull), (long)(left % 1000000000ull) };
+		doorbell_futex(&d->ready.count, FUTEX_WAIT, ready, &ts); //wakes on every mark
+	}
+}
+#endif
@@ -0,0 +1,386 @@
+// dungeon_bench.c
+// Microbenchmarks for the role hot paths. Prints one JSON document with median and tail
+// percentiles per benchmark so results can be compared across builds.
+//   wizard:    spell_decode kernels across spell lengths (checked against the scalar kernel first),
+//              and a hit in the wizard's spell cache for the lengths a barrier can have, and the
+//              in-place decode of large-spell mode (spell_workers.h) from 1 KiB to 16 MiB, per byte
+//   rogue:     pick_search convergence against a simulated lock, in ticks and compute time
+//   barbarian: doorbell ring -> enemy.health copied into attack, across two threads, and the same
+//              work as batches of queued attack commands (dungeon_queue.h), per command
+//   stats:     one stat_record() into a stats role block, the cost added to each event
+//   trace:     one trace_event() with tracing off (no ring) and on, the cost added to each hook
+//   shm:       shm_open + mmap + munmap of a struct Dungeon sized segment, as in create_shared_dungeon()
+#define _DEFAULT_SOURCE // syscall(), strnlen()
+
+#include <stdio.h> // printf()
+#include <stdlib.h> // malloc()
+#include <string.h> // memcmp()
+#include <pthread.h> // barbarian thread
+#include <fcntl.h> // O_* flags
+#include <unistd.h> // ftruncate()
+#include <sys/mman.h> // mmap()
+
+#include "dungeon_info.h" // struct Dungeon
+#include "dungeon_clock.h" // dungeon_now_ns(), dungeon_percentile()
+#include "dungeon_doorbell.h" // doorbell_ring(), doorbell_wait()
+#include "dungeon_atomic.h" // field accessors
+#include "spell_decode.h" // wizard kernels
+#include "spell_cache.h" // wizard decode cache
+#include "spell_workers.h" // large spells
+#include "pick_search.h" // rogue search
+#include "dungeon_stats.h" // stat_record()
+#include "dungeon_queue.h" // command queues
+#include "dungeon_trace.h" // trace_event()
+
+#define BENCH_SAMPLES (2001)
+
+static uint64_t g_samples[BENCH_SAMPLES];
+static int g_first = 1;
+
+// one JSON object per benchmark; extra is either "" or ", \"key\": value..."
+static void emit(const char *name, const char *unit, uint64_t *samples, size_t n, const char *extra) {
+    uint64_t p50 = dungeon_percentile(samples, n, 50.0);
+    uint64_t p90 = dungeon_percentile(samples, n, 90.0);
+    uint64_t p99 = dungeon_percentile(samples, n, 99.0);
+    uint64_t max = dungeon_percentile(samples, n, 100.0);
+    printf("%s\n    {\"name\": \"%s\", \"unit\": \"%s\", \"n\": %zu, \"median\": %llu, \"p90\": %llu, "
+           "\"p99\": %llu, \"max\": %llu%s}",
+           g_first ? "" : ",", name, unit, n, (unsigned long long)p50, (unsigned long long)p90,
+           (unsigned long long)p99, (unsigned long long)max, extra);
+    g_first = 0;
+}
+
+// ---- wizard ----
+
+typedef void (*kernel_fn)(char *, const char *, size_t, int);
+
+static void fill_spell(char *buf, size_t n, unsigned *seed) {
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ !,-.?'";
+    for (size_t i = 0; i < n; ++i) {
+        buf[i] = alphabet[rand_r(seed) % (sizeof(alphabet) - 1)];
+    }
+}
+
+static int bench_decode(void) {
+    static const size_t lengths[] = { 16, 64, SPELL_BUFFER_SIZE - 1, 256, 1024, 4096, 65536 };
+    const struct { const char *name; kernel_fn fn; } kernels[] = {
+        { "scalar", spell_decode_scalar },
+        { "sse2", spell_decode_sse2 },
+        { "avx2", spell_decode_avx2 },
+        { "dispatch", spell_decode_body },
+    };
+    size_t max_len = lengths[sizeof(lengths) / sizeof(lengths[0]) - 1];
+    char *in = malloc(max_len);
+    char *ref = malloc(max_len);
+    char *out = malloc(max_len);
+    if (!in || !ref || !out) return -1;
+
+    unsigned seed = 1;
+    fill_spell(in, max_len, &seed);
+
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l) {
+        size_t n = lengths[l];
+        spell_decode_scalar(ref, in, n, 7);
+        for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+            kernels[k].fn(out, in, n, 7);
+            if (memcmp(out, ref, n) != 0) { // never time a kernel that gives a different answer
+                fprintf(stderr, "bench: %s kernel disagrees with scalar at length %zu\n", kernels[k].name, n);
+                return -1;
+            }
+            size_t reps = n < 1024 ? 64 : 1;
+            for (size_t s = 0; s < BENCH_SAMPLES; ++s) {
+                uint64_t t0 = dungeon_now_ns();
+                for (size_t r = 0; r < reps; ++r) {
+                    kernels[k].fn(out, in, n, (int)(r % 26));
+                }
+                g_samples[s] = (dungeon_now_ns() - t0) / reps;
+            }
+            char name[64];
+            char extra[96];
+            snprintf(name, sizeof(name), "wizard.decode.%s.%zu", kernels[k].name, n);
+            uint64_t median = dungeon_percentile(g_samples, BENCH_SAMPLES, 50.0);
+            snprintf(extra, sizeof(extra), ", \"bytes\": %zu, \"mb_per_s\": %.1f", n,
+                     median ? (double)n * 1000.0 / (double)median : 0.0);
+            emit(name, "ns", g_samples, BENCH_SAMPLES, extra);
+        }
+    }
+    free(in);
+    free(ref);
+    free(out);
+    return 0;
+}
+
+// Hits only: the same spell each time, like a phrase the wizard has seen before
+static int bench_spell_cache(void) {
+    static const size_t lengths[] = { 16, 64, SPELL_BUFFER_SIZE - 1 };
+    static struct SpellCache cache;
+    char encoded[SPELL_BUFFER_SIZE + 1];
+    char out[SPELL_BUFFER_SIZE];
+    char ref[SPELL_BUFFER_SIZE];
+    unsigned seed = 3;
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l) {
+        size_t n = lengths[l];
+        spell_cache_init(&cache);
+        encoded[0] = 'h';
+        fill_spell(encoded + 1, n, &seed);
+        encoded[n + 1] = '\0';
+        spell_decode(ref, sizeof(ref), encoded, sizeof(encoded));
+        spell_cache_decode(&cache, out, sizeof(out), encoded, sizeof(encoded)); // miss, fills the entry
+        for (size_t s = 0; s < BENCH_SAMPLES; ++s) {
+            uint64_t t0 = dungeon_now_ns();
+            for (int r = 0; r < 64; ++r) {
+                spell_cache_decode(&cache, out, sizeof(out), encoded, sizeof(encoded));
+            }
+            g_samples[s] = (dungeon_now_ns() - t0) / 64;
+        }
+        if (strcmp(out, ref) != 0 || cache.misses != 1) {
+            fprintf(stderr, "bench: spell cache gave a different answer at length %zu\n", n);
+            return -1;
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "wizard.cache.hit.%zu", n);
+        emit(name, "ns", g_samples, BENCH_SAMPLES, "");
+    }
+    return 0;
+}
+
+// Large spells: the cost per byte should not depend on the size. Each sample decodes in place
+// again, which shifts the text further, so the answer is checked on a copy first.
+static int bench_spell_workers(void) {
+    static const size_t sizes[] = { 1 << 10, 64 << 10, 1 << 20, 16 << 20 };
+    struct SpellWorkers workers;
+    spell_workers_init(&workers, -1);
+    unsigned seed = 4;
+    int rc = 0;
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]) && rc == 0; ++k) {
+        size_t n = sizes[k];
+        char *text = malloc(n);
+        char *ref = malloc(n);
+        if (!text || !ref) {
+            free(text);
+            free(ref);
+            return -1;
+        }
+        fill_spell(text, n, &seed);
+        spell_decode_scalar(ref, text, n, 7);
+        spell_workers_decode(&workers, text, n, 7);
+        if (memcmp(text, ref, n) != 0) {
+            fprintf(stderr, "bench: parallel decode differs from the scalar kernel at %zu bytes\n", n);
+            rc = -1;
+        }
+        size_t samples = ((size_t)64 << 20) / n; // about 64 MiB decoded per size
+        if (samples > BENCH_SAMPLES) samples = BENCH_SAMPLES;
+        if (samples < 31) samples = 31;
+        for (size_t s = 0; s < samples && rc == 0; ++s) {
+            uint64_t t0 = dungeon_now_ns();
+            spell_workers_decode(&workers, text, n, 7);
+            g_samples[s] = (dungeon_now_ns() - t0) * 1000 / n;
+        }
+        if (rc == 0) {
+            char name[64];
+            char extra[64];
+            snprintf(name, sizeof(name), "wizard.large.%zuk", n >> 10);
+            snprintf(extra, sizeof(extra), ", \"threads\": %d", n >= SPELL_PARALLEL_MIN ? workers.count + 1 : 1);
+            emit(name, "ps/byte", g_samples, samples, extra);
+        }
+        free(text);
+        free(ref);
+    }
+    spell_workers_destroy(&workers);
+    return rc;
+}
+
+// ---- rogue ----
+
+// Simulated lock: answers like the dungeon's tick, one verdict per pick.
+static void bench_pick(const char *label, float max_angle, float threshold) {
+    static uint64_t ticks[BENCH_SAMPLES];
+    unsigned seed = 2;
+    for (size_t s = 0; s < BENCH_SAMPLES; ++s) {
+        float target = (float)rand_r(&seed) / (float)RAND_MAX * max_angle;
+        struct PickSearch search;
+        uint64_t t0 = dungeon_now_ns();
+        pick_search_init(&search, max_angle, threshold);
+        float pick = search.guess;
+        for (;;) {
+            float diff = pick - target;
+            if (diff <= threshold && diff >= -threshold) break;
+            pick = pick_search_feedback(&search, target > pick ? 'u' : 'd');
+        }
+        g_samples[s] = dungeon_now_ns() - t0;
+        ticks[s] = search.ticks;
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "rogue.pick.%s.ticks", label);
+    emit(name, "ticks", ticks, BENCH_SAMPLES, "");
+    snprintf(name, sizeof(name), "rogue.pick.%s.compute", label);
+    emit(name, "ns", g_samples, BENCH_SAMPLES, "");
+}
+
+// ---- barbarian ----
+
+static struct Dungeon *g_bench_dungeon = NULL;
+static struct DungeonQueues *g_bench_queues = NULL;
+
+static void *barbarian_thread(void *arg) {
+    (void)arg;
+    struct Dungeon *d = g_bench_dungeon;
+    uint32_t seen = atomic_load(&d->doorbell.generation[ROLE_BARBARIAN]);
+    for (;;) {
+        uint32_t bits = doorbell_wait(d, ROLE_BARBARIAN, &seen, -1, -1);
+        if (bits & DOORBELL_SHUTDOWN) break;
+        if (bits & DOORBELL_ENCOUNTER) dungeon_store_attack(d, dungeon_load_health(d));
+        if (bits & DOORBELL_QUEUE) { // like role_drain_queue()
+            struct RoleQueue *q = dungeon_queue(g_bench_queues, ROLE_BARBARIAN);
+            struct QueueCommand cmds[16];
+            struct QueueCompletion done[16];
+            uint32_t n;
+            while ((n = queue_take(q, cmds, 16)) > 0) {
+                for (uint32_t i = 0; i < n; ++i) {
+                    dungeon_store_attack(d, cmds[i].value);
+                    done[i] = (struct QueueCompletion){ .round = cmds[i].round, .type = cmds[i].type,
+                                                       .value = cmds[i].value, .doneNs = dungeon_now_ns() };
+                }
+                queue_complete(q, done, n);
+            }
+        }
+    }
+    return NULL;
+}
+
+// batch attack commands, one ring, wait for every completion; each sample is per command
+static void bench_queue(struct Dungeon *d, uint32_t batch) {
+    struct RoleQueue *q = dungeon_queue(g_bench_queues, ROLE_BARBARIAN);
+    struct QueueCommand cmds[QUEUE_DEPTH];
+    struct QueueCompletion done[QUEUE_DEPTH];
+    uint32_t round = 0;
+    for (size_t s = 0; s < BENCH_SAMPLES; ++s) {
+        for (uint32_t i = 0; i < batch; ++i) {
+            cmds[i] = (struct QueueCommand){ .round = round++, .type = QUEUE_ATTACK, .value = (int32_t)i };
+        }
+        uint64_t t0 = dungeon_now_ns();
+        queue_post(q, cmds, batch);
+        doorbell_ring(d, ROLE_BARBARIAN, DOORBELL_QUEUE);
+        for (uint32_t got = 0; got < batch;) {
+            uint32_t n = queue_reap(q, done, QUEUE_DEPTH);
+            if (n == 0) sched_yield();
+            got += n;
+        }
+        g_samples[s] = (dungeon_now_ns() - t0) / batch;
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "barbarian.queue.batch%u", batch);
+    emit(name, "ns/command", g_samples, BENCH_SAMPLES, "");
+}
+
+static int bench_barbarian(void) {
+    struct Dungeon *d = mmap(NULL, sizeof(*d), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (d == MAP_FAILED) return -1;
+    memset(d, 0, sizeof(*d));
+    for (int r = 0; r < NUM_ROLES; ++r) {
+        d->doorbell.eventFd[r] = -1; // futex only
+    }
+    g_bench_dungeon = d;
+    g_bench_queues = mmap(NULL, sizeof(*g_bench_queues), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (g_bench_queues == MAP_FAILED) return -1;
+
+    pthread_t t;
+    pthread_create(&t, NULL, barbarian_thread, NULL);
+    for (size_t s = 0; s < BENCH_SAMPLES; ++s) {
+        int health = (int)s + 1;
+        uint64_t t0 = dungeon_now_ns();
+        dungeon_publish_health(d, health, t0); // as local_dungeon.c does
+        doorbell_ring(d, ROLE_BARBARIAN, DOORBELL_ENCOUNTER);
+        while (dungeon_load_attack(d) != health) {
+            sched_yield(); // let the barbarian run on single-core hosts
+        }
+        g_samples[s] = dungeon_now_ns() - t0;
+    }
+    emit("barbarian.ring_to_attack", "ns", g_samples, BENCH_SAMPLES, "");
+    bench_queue(d, 1);
+    bench_queue(d, 8);
+    bench_queue(d, 32);
+    doorbell_ring(d, ROLE_BARBARIAN, DOORBELL_SHUTDOWN);
+    pthread_join(t, NULL);
+    munmap(g_bench_queues, sizeof(*g_bench_queues));
+    munmap(d, sizeof(*d));
+    return 0;
+}
+
+// ---- stats ----
+
+// Each sample times a batch, since a single record is shorter than a clock read
+#define STATS_BATCH (1000)
+
+static void bench_stats(void) {
+    static struct RoleStats block;
+    uint64_t v = 12345;
+    for (size_t s = 0; s < BENCH_SAMPLES; ++s) {
+        uint64_t t0 = dungeon_now_ns();
+        for (int i = 0; i < STATS_BATCH; ++i) {
+            stat_record(&block, METRIC_REACTION, v);
+            v = v * 2862933555777941757ull + 3037000493ull; // spread over the buckets
+            v >>= 40;
+        }
+        g_samples[s] = (dungeon_now_ns() - t0) / STATS_BATCH;
+    }
+    emit("stats.record", "ns", g_samples, BENCH_SAMPLES, "");
+}
+
+// ---- trace ----
+
+static void bench_trace(const char *name, struct TraceRing *ring) {
+    for (size_t s = 0; s < BENCH_SAMPLES; ++s) {
+        uint64_t t0 = dungeon_now_ns();
+        for (uint32_t i = 0; i < STATS_BATCH; ++i) {
+            trace_event(ring, TRACE_WRITE_ATTACK, i);
+        }
+        g_samples[s] = (dungeon_now_ns() - t0) / STATS_BATCH;
+    }
+    emit(name, "ns", g_samples, BENCH_SAMPLES, "");
+}
+
+// ---- shared memory ----
+
+static int bench_shm(void) {
+    const char *name = "/DungeonBench"; // never the live /DungeonMem
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0600);
+    if (fd == -1 || ftruncate(fd, sizeof(struct Dungeon)) == -1) {
+        perror("bench shm_open");
+        return -1;
+    }
+    close(fd);
+
+    for (size_t s = 0; s < BENCH_SAMPLES; ++s) {
+        uint64_t t0 = dungeon_now_ns();
+        fd = shm_open(name, O_RDWR, 0600);
+        struct Dungeon *d = mmap(NULL, sizeof(*d), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (d == MAP_FAILED) return -1;
+        ((volatile char *)d)[0]; // fault the page in like the first field access would
+        munmap(d, sizeof(*d));
+        g_samples[s] = dungeon_now_ns() - t0;
+    }
+    shm_unlink(name);
+    emit("shm.attach_map_unmap", "ns", g_samples, BENCH_SAMPLES, "");
+    return 0;
+}
+
+int main(void) {
+    printf("{\"decode_kernel\": \"%s\", \"sizeof_dungeon\": %zu, \"benchmarks\": [",
+           spell_decode_kernel_name(), sizeof(struct Dungeon));
+    int rc = 0;
+    if (bench_decode() != 0) rc = 1;
+    if (bench_spell_cache() != 0) rc = 1;
+    if (bench_spell_workers() != 0) rc = 1;
+    bench_pick("default", (float)MAX_PICK_ANGLE, (float)LOCK_THRESHOLD);
+    bench_pick("hard", (float)MAX_PICK_ANGLE * 1000.0f, (float)LOCK_THRESHOLD / 100.0f);
+    if (bench_barbarian() != 0) rc = 1;
+    bench_stats();
+    bench_trace("trace.event_off", NULL);
+    static struct TraceRing ring;
+    bench_trace("trace.event_on", &ring);
+    if (bench_shm() != 0) rc = 1;
+    printf("\n]}\n");
+    return rc;
+}
@@ -0,0 +1,111 @@
+#ifndef DUNGEON_CLOCK_H
+#define DUNGEON_CLOCK_H
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+//Monotonic time in nanoseconds. Every latency in the party is measured with this clock
+//so numbers from different processes can be compared directly.
+static inline uint64_t dungeon_now_ns(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+//Log2 histogram buckets: bucket b counts latencies in [2^b, 2^(b+1)) ns, the last one everything above.
+#define LATENCY_BUCKETS (40)
+
+//Running count/mean/max of a latency plus a log2 histogram, cheap enough to update on every wakeup.
+struct LatencyStats{
+	uint64_t count;
+	uint64_t totalNs;
+	uint64_t maxNs;
+	uint32_t log2[LATENCY_BUCKETS];
+};
+
+static inline int latency_bucket(uint64_t ns){
+	int b = ns ? 63 - __builtin_clzll(ns) : 0;
+	return b < LATENCY_BUCKETS ? b : LATENCY_BUCKETS - 1;
+}
+
+static inline void latency_record(struct LatencyStats *s, uint64_t ns){
+	s->count++;
+	s->totalNs += ns;
+	if (ns > s->maxNs) s->maxNs = ns;
+	s->log2[latency_bucket(ns)]++;
+}
+
+//Histograms are printed when DUNGEON_HISTOGRAMS is set to anything but 0, so runs with and
+//without the real-time profile (dungeon_rt.h) can be compared.
+static inline bool latency_histograms_enabled(void){
+	const char *e = getenv("DUNGEON_HISTOGRAMS");
+	return e && *e && strcmp(e, "0") != 0;
+}
+
+//1024 -> "1us", 2^31 -> "2s": the lower bound of a bucket, in the largest whole unit.
+static inline void latency_bucket_label(char *buf, size_t size, int b){
+	static const char *const units[] = { "ns", "us", "ms", "s" };
+	uint64_t v = 1ull << b;
+	int u = 0;
+	while (u < 3 && v >= 1000) {
+		v /= 1000;
+		++u;
+	}
+	snprintf(buf, size, "%llu%s", (unsigned long long)v, units[u]);
+}
+
+//One line per non-empty bucket, each starting with prefix, with a bar scaled to the fullest bucket.
+static inline void latency_histogram_print(FILE *out, const char *prefix, const struct LatencyStats *s){
+	uint32_t top = 0;
+	for (int b = 0; b < LATENCY_BUCKETS; ++b) {
+		if (s->log2[b] > top) top = s->log2[b];
+	}
+	if (top == 0) return;
+	for (int b = 0; b < LATENCY_BUCKETS; ++b) {
+		if (s->log2[b] == 0) continue;
+		char lo[16];
+		char hi[16];
+		latency_bucket_label(lo, sizeof(lo), b);
+		latency_bucket_label(hi, sizeof(hi), b + 1);
+		char bar[41];
+		int len = (int)((uint64_t)s->log2[b] * 40 / top);
+		if (len == 0) len = 1;
+		memset(bar, '#', (size_t)len);
+		bar[len] = '\0';
+		fprintf(out, "%s%6s-%-6s %8u %s\n", prefix, lo, hi, s->log2[b], bar);
+	}
+}
+
+static inline void latency_print(const char *who, const char *what, const struct LatencyStats *s){
+	if (s->count == 0) {
+		printf("[%s] %s: no samples\n", who, what);
+		return;
+	}
+	printf("[%s] %s: n=%llu mean=%.1fus max=%.1fus\n", who, what,
+	       (unsigned long long)s->count,
+	       (double)s->totalNs / (double)s->count / 1000.0,
+	       (double)s->maxNs / 1000.0);
+	if (latency_histograms_enabled()) {
+		char prefix[64];
+		snprintf(prefix, sizeof(prefix), "[%s]   ", who);
+		latency_histogram_print(stdout, prefix, s);
+	}
+}
+
+static inline int dungeon_cmp_u64(const void *a, const void *b){
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+//pct-th percentile (0-100) of n samples. Sorts the samples in place.
+static inline uint64_t dungeon_percentile(uint64_t *samples, size_t n, double pct){
+	if (n == 0) return 0;
+	qsort(samples, n, sizeof(samples[0]), dungeon_cmp_u64);
+	size_t idx = (size_t)(pct / 100.0 * (double)(n - 1) + 0.5);
+	return samples[idx < n ? idx : n - 1];
+}
+#endif
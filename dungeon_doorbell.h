@@ -0,0 +1,120 @@
+#ifndef DUNGEON_DOORBELL_H
+#define DUNGEON_DOORBELL_H
+//Doorbell helpers for struct Doorbell in dungeon_info.h.
+//Files that include this need _DEFAULT_SOURCE (or _GNU_SOURCE) for syscall().
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "dungeon_info.h"
+#include "dungeon_clock.h"
+
+static inline long doorbell_futex(_Atomic uint32_t *word, int op, uint32_t val, const struct timespec *timeout){
+	//not FUTEX_PRIVATE: the word lives in memory shared between processes
+	return syscall(SYS_futex, (uint32_t *)word, op, val, timeout, NULL, 0);
+}
+
+//Called once by whoever creates the shared memory, before the roles are started, so the
+//eventfds are inherited across fork()/exec().
+static inline void doorbell_init(struct Dungeon *d){
+	for (int r = 0; r < NUM_ROLES; ++r) {
+		atomic_store(&d->doorbell.generation[r], 0);
+		atomic_store(&d->doorbell.pending[r], 0);
+		atomic_store(&d->doorbell.rungAtNs[r], 0);
+		d->doorbell.eventFd[r] = eventfd(0, EFD_NONBLOCK);
+		if (d->doorbell.eventFd[r] == -1) {
+			perror("doorbell eventfd"); //not fatal, the futex path still works
+		}
+	}
+}
+
+static inline void doorbell_close(struct Dungeon *d){
+	for (int r = 0; r < NUM_ROLES; ++r) {
+		if (d->doorbell.eventFd[r] >= 0) close(d->doorbell.eventFd[r]);
+		d->doorbell.eventFd[r] = -1;
+	}
+}
+
+//Returns the role's eventfd if this process really inherited it, -1 otherwise.
+//A role started by hand may have some unrelated file open under the same number.
+static inline int doorbell_attach(struct Dungeon *d, enum DungeonRole role){
+	int fd = d->doorbell.eventFd[role];
+	if (fd < 0) return -1;
+
+	char path[64];
+	char link[64];
+	snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+	ssize_t n = readlink(path, link, sizeof(link) - 1);
+	if (n <= 0) return -1;
+	link[n] = '\0';
+	return strcmp(link, "anon_inode:[eventfd]") == 0 ? fd : -1;
+}
+
+//Ring a role's doorbell. Only uses async-signal-safe calls so it can be rung from a signal handler.
+static inline void doorbell_ring(struct Dungeon *d, enum DungeonRole role, uint32_t bits){
+	struct Doorbell *b = &d->doorbell;
+	atomic_fetch_or_explicit(&b->pending[role], bits, memory_order_release);
+	atomic_store_explicit(&b->rungAtNs[role], dungeon_now_ns(), memory_order_relaxed);
+	atomic_fetch_add_explicit(&b->generation[role], 1, memory_order_release);
+	doorbell_futex(&b->generation[role], FUTEX_WAKE, INT_MAX, NULL);
+
+	int fd = b->eventFd[role];
+	if (fd >= 0) {
+		uint64_t one = 1;
+		ssize_t w = write(fd, &one, sizeof(one)); //only works in processes that share the fd
+		(void)w;
+	}
+}
+
+//Take the pending bits after a wakeup.
+static inline uint32_t doorbell_take(struct Dungeon *d, enum DungeonRole role){
+	return atomic_exchange_explicit(&d->doorbell.pending[role], 0, memory_order_acquire);
+}
+
+//Block until the role's doorbell has pending bits, or timeoutMs passes (-1 waits forever).
+//*seen is updated to the last generation observed.
+//Returns the DOORBELL_* bits that were pending, or 0 on timeout.
+//eventFd is the value from doorbell_attach(); it is only used if futexes are unavailable.
+static inline uint32_t doorbell_wait(struct Dungeon *d, enum DungeonRole role, uint32_t *seen, int eventFd, int timeoutMs){
+	struct Doorbell *b = &d->doorbell;
+	uint64_t deadline = timeoutMs < 0 ? 0 : dungeon_now_ns() + (uint64_t)timeoutMs * 1000000ull;
+
+	for (;;) {
+		//read the generation before the bits: a ring that lands in between moves the
+		//generation, so the futex wait below returns at once instead of missing it
+		uint32_t gen = atomic_load_explicit(&b->generation[role], memory_order_acquire);
+		*seen = gen;
+		uint32_t bits = doorbell_take(d, role);
+		if (bits) return bits; //also catches rings from before this role started waiting
+
+		struct timespec ts;
+		struct timespec *tsp = NULL;
+		if (timeoutMs >= 0) {
+			uint64_t now = dungeon_now_ns();
+			if (now >= deadline) return 0;
+			uint64_t left = deadline - now;
+			ts.tv_sec = (time_t)(left / 1000000000ull);
+			ts.tv_nsec = (long)(left % 1000000000ull);
+			tsp = &ts;
+		}
+
+		if (doorbell_futex(&b->generation[role], FUTEX_WAIT, gen, tsp) == -1 && errno == ENOSYS) {
+			if (eventFd < 0) return 0; //nothing to block on
+			struct pollfd pfd = { .fd = eventFd, .events = POLLIN };
+			int left = timeoutMs < 0 ? -1 : (int)((deadline - dungeon_now_ns()) / 1000000ull);
+			if (poll(&pfd, 1, left) > 0) {
+				uint64_t count;
+				ssize_t r = read(eventFd, &count, sizeof(count)); //drain
+				(void)r;
+			}
+		}
+		//EAGAIN (generation moved), EINTR and ETIMEDOUT all loop back to the checks above
+	}
+}
+#endif
@@ -0,0 +1,143 @@
+// dungeon_driver.c
+// Local dungeon driver: same setup as game.c, but the rounds are played by local_dungeon.c
+// instead of the prebuilt RunDungeon(), so the timing windows and round count are ours.
+// Turbo mode (-t) shrinks the windows to milliseconds for load testing the roles.
+
+#define _DEFAULT_SOURCE // POSIX plus syscall() for the doorbell futex
+
+#include <stdio.h> // printf()
+#include <stdlib.h> // exit(), atol()
+#include <unistd.h> // getopt(), usleep()
+#include <fcntl.h> // O_CREAT
+#include <signal.h> // kill()
+#include <semaphore.h> // levers
+#include <sys/mman.h> // munmap()
+#include <sys/wait.h> // waitpid()
+
+#include "dungeon_info.h" // shared memory struct and semaphore names
+#include "dungeon_settings.h" // gameplay constants
+#include "dungeon_doorbell.h" // role wakeups
+#include "dungeon_launch.h" // create_shared_dungeon(), start_process(), stop_roles()
+#include "dungeon_supervise.h" // respawn crashed roles
+#include "dungeon_atomic.h" // dungeon_set_running()
+#include "local_dungeon.h" // the round engine
+#include "spell_arena.h" // the spells extension for -L
+#include "dungeon_queue.h" // the queues extension for -Q
+#include "dungeon_log.h" // the round log for -o
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-t] [-s] [-v] [-n rounds] [-T treasure_rooms] [-S seed] [-L spell_bytes] [-Q batch]\n"
+            "          [-a attack_us] [-b barrier_us] [-p pick_us] [-k tick_us] [-r treasure_us] [-P poll_us] [-o log]\n"
+            "  -t  turbo: millisecond windows instead of the ones in dungeon_settings.h\n"
+            "  -s  notify roles with DUNGEON_SIGNAL/SEMAPHORE_SIGNAL instead of the doorbell\n"
+            "  -v  print every round\n"
+            "  -L  large-spell mode: barrier spells of this many bytes in a spell arena\n"
+            "  -Q  queue mode: monster and barrier rounds go to the roles' command queues, this many at a time\n"
+            "  -o  log every round, as it is published and judged, for dungeon_replay\n",
+            prog);
+}
+
+int main(int argc, char **argv) {
+    // turbo changes the defaults, so look for it before the other options
+    bool turbo = false;
+    for (int i = 1; i < argc; ++i) {
+        if (argv[i][0] == '-' && argv[i][1] == 't') turbo = true;
+    }
+    struct LocalDungeonConfig cfg;
+    local_dungeon_defaults(&cfg, turbo);
+    const char *logPath = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "tsvn:T:S:L:Q:a:b:p:k:r:P:o:")) != -1) {
+        switch (opt) {
+        case 't': break;
+        case 's': cfg.useSignals = true; break;
+        case 'v': cfg.verbose = true; break;
+        case 'n': cfg.rounds = atoi(optarg); break;
+        case 'T': cfg.treasureRounds = atoi(optarg); break;
+        case 'S': cfg.seed = (unsigned)atol(optarg); break;
+        case 'L': cfg.spellBytes = (size_t)atoll(optarg); break;
+        case 'Q': cfg.queueBatch = atoi(optarg); break;
+        case 'a': cfg.attackUs = atol(optarg); break;
+        case 'b': cfg.barrierUs = atol(optarg); break;
+        case 'p': cfg.pickUs = atol(optarg); break;
+        case 'k': cfg.tickUs = atol(optarg); break;
+        case 'r': cfg.treasureUs = atol(optarg); break;
+        case 'P': cfg.pollUs = atol(optarg); break;
+        case 'o': logPath = optarg; break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if (cfg.queueBatch > 0 && cfg.useSignals) {
+        fprintf(stderr, "dungeon_driver: -Q needs the doorbell, a signal can't say which queue\n");
+        return 1;
+    }
+
+    dungeon_rt_apply("Dungeon", DUNGEON_RT_GAME); // opt-in real-time profile, see dungeon_rt.h
+    uint64_t launchNs = dungeon_now_ns();
+    size_t arenaBytes = local_dungeon_arena_capacity(&cfg);
+    struct Dungeon *d = create_shared_dungeon(arenaBytes ? spell_arena_bytes(arenaBytes) : 0);
+    d->dungeonPID = getpid();
+
+    sem_t *lever1;
+    sem_t *lever2;
+    open_levers(&lever1, &lever2);
+
+    // before the wizard starts, so it finds the arena
+    struct SpellArena *spells = NULL;
+    if (arenaBytes) {
+        spells = spell_arena_create(arenaBytes);
+        if (!spells) {
+            perror("dungeon_driver: spell arena");
+            exit(1);
+        }
+    }
+
+    pid_t pids[NUM_ROLES];
+    pids[ROLE_BARBARIAN] = start_process("barbarian", "./barbarian");
+    pids[ROLE_WIZARD]    = start_process("wizard",    "./wizard");
+    pids[ROLE_ROGUE]     = start_process("rogue",     "./rogue");
+    trace_event(g_trace, TRACE_MARK, TRACE_ROLES_SPAWNED);
+    if (dungeon_wait_ready(d, NUM_ROLES, 5000) < NUM_ROLES) {
+        fprintf(stderr, "dungeon_driver: not every role became ready, starting anyway\n");
+    }
+    report_ready("Dungeon", d, launchNs);
+
+    struct RoleSupervisor sup;
+    supervisor_start(&sup, "Dungeon", d, pids, cfg.useSignals); // -s signals the original pids
+
+    struct LocalDungeon ld;
+    local_dungeon_init(&ld, d, pids, lever1, lever2, &cfg);
+    ld.spells = spells;
+    if (cfg.queueBatch > 0) {
+        ld.queues = dungeon_queues_open();
+        if (!ld.queues) {
+            perror("dungeon_driver: command queues");
+            exit(1);
+        }
+    }
+    struct DungeonLogWriter log;
+    if (logPath) {
+        if (dungeon_log_create(&log, logPath, dungeon_now_ns(), 0) == -1) {
+            perror(logPath);
+            exit(1);
+        }
+        ld.log = &log;
+    }
+    trace_event(g_trace, TRACE_MARK, TRACE_DUNGEON_START);
+    local_dungeon_run(&ld);
+    trace_event(g_trace, TRACE_MARK, TRACE_DUNGEON_END);
+    if (ld.log) dungeon_log_finish(ld.log);
+
+    supervisor_finish(&sup, 3000);
+
+    local_dungeon_report(&ld, stdout);
+    local_dungeon_free(&ld);
+
+    dungeon_queues_close(ld.queues);
+    spell_arena_close(spells);
+    close_levers(lever1, lever2);
+    destroy_shared_dungeon(d);
+    return 0;
+}
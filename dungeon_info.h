@@ -1,22 +1,35 @@
 #ifndef DUNGEON_INFO_H
 #define DUNGEON_INFO_H
+#include <stdalign.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
 #include <unistd.h>
 #include "dungeon_settings.h"
 
 //This is the name we will use for our shared memory.
-const char* dungeon_shm_name = "/DungeonMem";
+static const char* const dungeon_shm_name = "/DungeonMem";
 
 //These are the names for the levers when getting the treasure at the end.
-const char* dungeon_lever_one = "/LeverOne";
-const char* dungeon_lever_two = "/LeverTwo";
+static const char* const dungeon_lever_one = "/LeverOne";
+static const char* const dungeon_lever_two = "/LeverTwo";
 
+//Posted by the rogue once spoils holds the treasure, so the barbarian can let go of the levers.
+static const char* const dungeon_spoils_ready = "/SpoilsReady";
 
+//Per-process event rings, only while tracing (dungeon_trace.h).
+static const char* const dungeon_trace_name = "/DungeonTrace";
+
+
+//Scalars shared between processes are _Atomic so every access has a defined ordering.
+//They have the same size and alignment as the plain types the prebuilt library was built with.
+//Read and write them through dungeon_atomic.h.
 struct Barbarian{
-	int attack;
+	_Atomic int attack;
 };
 struct Rogue{
-	float pick;
+	_Atomic float pick;
 };
 struct Wizard{
 	char spell[SPELL_BUFFER_SIZE];
@@ -25,14 +38,115 @@ struct Barrier{
 	char spell[SPELL_BUFFER_SIZE + 1];
 };
 struct Enemy{
-	int health;
+	_Atomic int health;
 };
 struct Trap{
-	char direction;
-	bool locked;
+	_Atomic char direction;
+	_Atomic bool locked;
+};
+//Slots in the doorbell area, one per role. Same order as the arguments of RunDungeon().
+enum DungeonRole{
+	ROLE_WIZARD = 0,
+	ROLE_ROGUE = 1,
+	ROLE_BARBARIAN = 2,
+	NUM_ROLES = 3
+};
+
+//Bits that say why a role's doorbell was rung.
+#define DOORBELL_ENCOUNTER (1u << 0) //same meaning as DUNGEON_SIGNAL
+#define DOORBELL_SEMAPHORE (1u << 1) //same meaning as SEMAPHORE_SIGNAL
+#define DOORBELL_SHUTDOWN  (1u << 2) //the game is ending, stop waiting
+#define DOORBELL_QUEUE     (1u << 3) //commands are waiting in the role's queue (dungeon_queue.h)
+
+//Wakeup area for the roles. Ringing bumps the role's generation and wakes it through a futex
+//on that counter, or through the role's eventfd when one was inherited from the game.
+//Unlike signals, two rings in a row are never merged: the generation still counts both.
+struct Doorbell{
+	_Atomic uint32_t generation[NUM_ROLES];
+	_Atomic uint32_t pending[NUM_ROLES]; //DOORBELL_* bits not yet seen by the role
+	_Atomic uint64_t rungAtNs[NUM_ROLES]; //dungeon_now_ns() of the last ring, for latency
+	int eventFd[NUM_ROLES]; //eventfd numbers as inherited by the roles, -1 if none
+};
+
+//Sequence counters for the multi-byte fields (barrier.spell, treasure), see dungeon_atomic.h.
+//Odd while a write is in progress. The prebuilt library never touches them, so they stay 0.
+struct DungeonSeq{
+	_Atomic uint32_t spell;
+	_Atomic uint32_t treasure;
+};
+
+//Monster rounds of the local dungeon (dungeon_publish_health()): a seqlock count over the health
+//and when it was published, odd while a publish is under way. The prebuilt library never touches
+//them, so they stay 0 and the barbarian falls back to watching enemy.health itself.
+struct EnemyWatch{
+	_Atomic uint32_t generation;
+	_Atomic uint64_t publishedNs; //dungeon_now_ns() of the last publish
+};
+
+//Start-up barrier. Each role bumps count once it can take events; the launcher waits on it
+//(futex on count) before starting the dungeon.
+struct DungeonReady{
+	_Atomic uint32_t count;
+	_Atomic uint64_t readyAtNs[NUM_ROLES]; //dungeon_now_ns() when each role became ready
+};
+
+//Hot standbys (dungeon_supervise.h): a standby role maps the dungeon, then sleeps on its slot
+//until the launcher stores the standby's pid there to promote it.
+struct DungeonStandby{
+	_Atomic uint32_t promote[NUM_ROLES];
+};
+
+//Treasure room handoff, next to the /SpoilsReady semaphore.
+struct TreasureRoom{
+	_Atomic uint64_t spoilsDoneNs; //dungeon_now_ns() when the rogue posted /SpoilsReady
+};
+
+#define DUNGEON_CACHE_LINE (64)
+
+//Command queues (dungeon_queue.h): per role, a single-producer single-consumer ring of
+//encounters from the dungeon and one of completions back, so encounters can be queued instead
+//of being one signal each. The counters only grow; a slot is counter % QUEUE_DEPTH.
+#define QUEUE_DEPTH (64u) //power of two
+
+struct QueueCommand{
+	uint32_t round;    //the dungeon's round number
+	uint16_t type;     //enum QueueCommandType
+	uint16_t reserved;
+	int32_t value;     //attack: enemy health
+	uint32_t length;   //decode: bytes of the spell record
+	uint64_t ref;      //decode: offset of the spell record in the spell arena
+	uint64_t postedNs; //dungeon_now_ns() when it was queued
 };
+
+struct QueueCompletion{
+	uint32_t round;
+	uint16_t type;
+	uint16_t status;   //0 done, else the command was not understood
+	int32_t value;     //attack: what was written to barbarian.attack
+	uint32_t length;   //decode: plaintext bytes
+	uint64_t ref;      //decode: offset of the plaintext in the spell arena
+	uint64_t doneNs;   //dungeon_now_ns() when it was completed
+};
+
+struct RoleQueue{
+	//written by the dungeon
+	alignas(DUNGEON_CACHE_LINE) _Atomic uint32_t posted;  //commands ever queued
+	_Atomic uint32_t reaped;                               //completions ever taken back
+	//written by the role
+	alignas(DUNGEON_CACHE_LINE) _Atomic uint32_t taken;   //commands ever taken
+	_Atomic uint32_t completed;                            //completions ever queued
+	alignas(DUNGEON_CACHE_LINE) struct QueueCommand command[QUEUE_DEPTH];
+	struct QueueCompletion completion[QUEUE_DEPTH];
+};
+
+struct DungeonQueues{
+	struct RoleQueue role[NUM_ROLES];
+};
+
+#ifndef DUNGEON_PARTITIONED_LAYOUT
+//The prebuilt dungeon library only knows the fields up to spoils, so new fields go at the end.
 struct Dungeon{
-	bool running;
+	_Atomic bool running;
 	pid_t dungeonPID;
 	struct Barbarian barbarian;
 	struct Rogue rogue;
@@ -42,8 +156,69 @@ struct Dungeon{
 	struct Trap trap;
 	char treasure[4];
 	char spoils[4];
+	struct Doorbell doorbell;
+	struct DungeonSeq seq;
+	struct DungeonReady ready;
+	struct TreasureRoom room;
+	struct DungeonStandby standby;
+	struct EnemyWatch watch;
 };
 
+//Offsets hardcoded in dungeon_ARM64.o / dungeon_X86_64.o. If one of these fails the library
+//will read and write the wrong bytes.
+_Static_assert(offsetof(struct Dungeon, barbarian) == 0x08, "barbarian moved");
+_Static_assert(offsetof(struct Dungeon, rogue) == 0x0c, "rogue moved");
+_Static_assert(offsetof(struct Dungeon, wizard) == 0x10, "wizard moved");
+_Static_assert(offsetof(struct Dungeon, barrier) == 0x74, "barrier moved");
+_Static_assert(offsetof(struct Dungeon, enemy) == 0xdc, "enemy moved");
+_Static_assert(offsetof(struct Dungeon, trap) == 0xe0, "trap moved");
+_Static_assert(offsetof(struct Dungeon, treasure) == 0xe2, "treasure moved");
+_Static_assert(offsetof(struct Dungeon, spoils) == 0xe6, "spoils moved");
+_Static_assert(sizeof(struct Trap) == 2 && sizeof(struct Rogue) == sizeof(float)
+               && sizeof(struct Barbarian) == sizeof(int), "atomic fields changed size");
+#else
+//Partitioned layout: every writer gets its own cache lines, so the rogue storing to rogue.pick
+//on every tick no longer invalidates the line the dungeon and the barbarian read.
+//The prebuilt dungeon library cannot use this layout; only in-tree code can.
+struct Dungeon{
+	//read-mostly, written by the dungeon between rounds
+	alignas(DUNGEON_CACHE_LINE) _Atomic bool running;
+	pid_t dungeonPID;
+	struct Enemy enemy;
+	char treasure[4];
+	struct DungeonSeq seq;
+	struct Barrier barrier;
+	//written by the dungeon every tick and by the rogue's verdict marker
+	alignas(DUNGEON_CACHE_LINE) struct Trap trap;
+	//written by the dungeon once per monster, read by the barbarian
+	alignas(DUNGEON_CACHE_LINE) struct EnemyWatch watch;
+	//one group per role, each written only by that role
+	alignas(DUNGEON_CACHE_LINE) struct Barbarian barbarian;
+	alignas(DUNGEON_CACHE_LINE) struct Rogue rogue;
+	alignas(DUNGEON_CACHE_LINE) char spoils[4];
+	struct TreasureRoom room; //written by the rogue, like spoils
+	alignas(DUNGEON_CACHE_LINE) struct Wizard wizard;
+	alignas(DUNGEON_CACHE_LINE) struct Doorbell doorbell;
+	alignas(DUNGEON_CACHE_LINE) struct DungeonReady ready;
+	struct DungeonStandby standby; //launcher-written, like ready
+};
+
+#define DUNGEON_LINE_OF(field) (offsetof(struct Dungeon, field) / DUNGEON_CACHE_LINE)
+_Static_assert(offsetof(struct Dungeon, running) == 0, "dungeon group must start the struct");
+_Static_assert(offsetof(struct Dungeon, barrier) + sizeof(struct Barrier) <= offsetof(struct Dungeon, trap),
+               "dungeon group spills into the trap line");
+_Static_assert(offsetof(struct Dungeon, trap) % DUNGEON_CACHE_LINE == 0, "trap not line aligned");
+_Static_assert(offsetof(struct Dungeon, barbarian) % DUNGEON_CACHE_LINE == 0, "barbarian not line aligned");
+_Static_assert(offsetof(struct Dungeon, rogue) % DUNGEON_CACHE_LINE == 0, "rogue not line aligned");
+_Static_assert(offsetof(struct Dungeon, spoils) % DUNGEON_CACHE_LINE == 0, "spoils not line aligned");
+_Static_assert(offsetof(struct Dungeon, wizard) % DUNGEON_CACHE_LINE == 0, "wizard not line aligned");
+_Static_assert(offsetof(struct Dungeon, doorbell) % DUNGEON_CACHE_LINE == 0, "doorbell not line aligned");
+_Static_assert(DUNGEON_LINE_OF(barbarian) != DUNGEON_LINE_OF(rogue), "barbarian shares a line with rogue");
+_Static_assert(sizeof(struct Barbarian) <= DUNGEON_CACHE_LINE && sizeof(struct Rogue) <= DUNGEON_CACHE_LINE
+               && sizeof(struct Trap) <= DUNGEON_CACHE_LINE, "single-line groups grew past a line");
+_Static_assert(sizeof(struct Dungeon) % DUNGEON_CACHE_LINE == 0, "struct Dungeon must end on a line");
+#endif
+
 //Call this method to begin running the dungeon. Valid pid's must be passed for it to work.
 void RunDungeon(pid_t wizard, pid_t rogue, pid_t barbarian);
 #endif
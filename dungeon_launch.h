@@ -0,0 +1,260 @@
+#ifndef DUNGEON_LAUNCH_H
+#define DUNGEON_LAUNCH_H
+//Shared-memory setup and role process start-up, used by game.c and the local dungeon driver.
+//Files that include this need _DEFAULT_SOURCE (or _GNU_SOURCE).
+#include <stdio.h> // perror()
+#include <stdlib.h> // exit()
+#include <string.h> // memset()
+#include <unistd.h> // ftruncate()
+#include <fcntl.h> // O_* flags
+#include <sys/mman.h> // shm_open(), mmap()
+#include <sys/stat.h> // mode constants
+#include <spawn.h> // posix_spawn()
+#include <poll.h> // poll() on pidfds
+#include <signal.h> // kill()
+#include <semaphore.h> // levers
+#include <sys/syscall.h> // SYS_pidfd_open
+#include <sys/wait.h> // waitpid()
+
+#include "dungeon_info.h" // struct Dungeon and the shared memory name
+#include "dungeon_doorbell.h" // doorbell_init()
+#include "dungeon_atomic.h" // dungeon_set_running()
+#include "dungeon_attach.h" // DUNGEON_SHM_FD_ENV
+#include "dungeon_clock.h" // dungeon_now_ns()
+#include "dungeon_names.h" // per-instance shm and semaphore names
+#include "dungeon_rt.h" // dungeon_rt_prefault()
+#include "dungeon_segment.h" // header and extensions of /DungeonMem
+#include "dungeon_stats.h" // the stats extension, for dungeonstat
+#include "dungeon_trace.h" // /DungeonTrace with DUNGEON_TRACE set
+
+extern char **environ;
+
+// Descriptor of /DungeonMem, kept open (and inheritable) so spawned roles can map it
+// without going through shm_open(). Its number is passed to them in DUNGEON_SHM_FD.
+static int g_dungeon_shm_fd = -1;
+
+// Live metrics in the stats extension of /DungeonMem, NULL if it could not be mapped.
+static struct DungeonStats *g_dungeon_stats = NULL;
+
+// Event rings (DUNGEON_TRACE), and the launcher's own ring in it; both NULL when not tracing.
+static struct DungeonTrace *g_dungeon_trace = NULL;
+static struct TraceRing *g_trace = NULL;
+
+// Helper to create shared memory for Dungeon struct: the struct, the segment header and the
+// extensions (dungeon_segment.h). spellArenaBytes lays out a large-spell arena too, 0 for none.
+// The segment is built under a private name and renamed to the real one once the header and the
+// struct are set up, so a role or dungeon_record that opens the name never sees it half made.
+static struct Dungeon* create_shared_dungeon(size_t spellArenaBytes) {
+    char building[DUNGEON_NAME_MAX + 16]; // '~' can not appear in an instance name
+    snprintf(building, sizeof(building), "%s~%d", dungeon_names()->shm, (int)getpid());
+    shm_unlink(building); // left by a launcher with our pid that crashed here
+    int fd = shm_open(building, O_CREAT | O_EXCL | O_RDWR, 0666);//create fresh (all zero), read and write, permission for everyone
+    if (fd == -1) {
+        perror("shm_open");
+        exit(1);
+    }
+
+    struct DungeonHeader header;
+    dungeon_segment_layout(&header);
+    dungeon_segment_add(&header, DUNGEON_EXT_QUEUES, sizeof(struct DungeonQueues));
+    dungeon_segment_add(&header, DUNGEON_EXT_STATS, sizeof(struct DungeonStats));
+    dungeon_segment_add(&header, DUNGEON_EXT_SPELLS, spellArenaBytes);
+    if (ftruncate(fd, (off_t)header.segmentSize) == -1) {
+        perror("ftruncate");
+        shm_unlink(building);
+        exit(1);
+    }
+    if (pwrite(fd, &header, sizeof(header), (off_t)DUNGEON_HEADER_OFFSET) != (ssize_t)sizeof(header)) {
+        perror("dungeon header");
+        shm_unlink(building);
+        exit(1);
+    }
+// map shared memory into the game process
+    struct Dungeon *d =
+        mmap(NULL, sizeof(struct Dungeon),
+             PROT_READ | PROT_WRITE, // read and write access
+             MAP_SHARED, // visible to child process
+             fd,
+             0);
+
+    if (d == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    dungeon_rt_prefault("Dungeon", d, sizeof(struct Dungeon)); // only with DUNGEON_RT set
+
+    // shm_open() sets FD_CLOEXEC; clear it so the roles inherit the descriptor
+    fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) & ~FD_CLOEXEC);
+    g_dungeon_shm_fd = fd;
+    char fdText[16];
+    snprintf(fdText, sizeof(fdText), "%d", fd);
+    setenv(DUNGEON_SHM_FD_ENV, fdText, 1);
+
+//initizalze the dungeon stuct to zeros
+    memset(d, 0, sizeof(struct Dungeon));
+    doorbell_init(d); // eventfds are created here so the roles inherit them
+    dungeon_set_running(d, true); // set running flag so other known dungeon is active
+
+    // publish: the rename replaces a segment left by a crashed run in one step
+    char from[DUNGEON_NAME_MAX + 32];
+    char to[DUNGEON_NAME_MAX + 16];
+    snprintf(from, sizeof(from), "/dev/shm%s", building);
+    snprintf(to, sizeof(to), "/dev/shm%s", dungeon_names()->shm);
+    if (rename(from, to) == -1) {
+        perror("publish /DungeonMem");
+        shm_unlink(building);
+        exit(1);
+    }
+
+    g_dungeon_stats = dungeon_stats_create(); // before the roles start, so they find it
+    if (!g_dungeon_stats) {
+        perror("dungeon stats"); // not fatal, the roles just keep no live metrics
+    }
+    g_dungeon_trace = dungeon_trace_create();
+    g_trace = dungeon_trace_ring(g_dungeon_trace, TRACE_SLOT_LAUNCHER);
+
+    return d;
+}
+
+// Helper to start one process with the environment env; -1 if it could not be started.
+// posix_spawn() lets libc use vfork/clone(CLONE_VM), so nothing of the launcher's address
+// space is copied.
+static pid_t start_process_env(const char *name, const char *path, char *const env[]) {
+    char *const argv[] = { (char *)name, NULL };
+    pid_t pid;
+    int rc = posix_spawn(&pid, path, NULL, NULL, argv, env);
+    if (rc != 0) {
+        fprintf(stderr, "posix_spawn %s: %s\n", path, strerror(rc));
+        return -1;
+    }
+    return pid;
+}
+
+// Start-up: a role that cannot be started ends the launcher.
+static pid_t start_process(const char *name, const char *path) {
+    pid_t pid = start_process_env(name, path, environ);
+    if (pid == -1) exit(1);
+    return pid;
+}
+
+// Print how long each role took to become ready, measured from launchNs.
+static void report_ready(const char *who, struct Dungeon *d, uint64_t launchNs) {
+    static const char *const names[NUM_ROLES] = { "wizard", "rogue", "barbarian" };
+    uint64_t last = 0;
+    trace_event(g_trace, TRACE_MARK, TRACE_ROLES_READY);
+    printf("[%s] time to ready:", who);
+    for (int r = 0; r < NUM_ROLES; ++r) {
+        uint64_t at = atomic_load_explicit(&d->ready.readyAtNs[r], memory_order_relaxed);
+        if (at == 0) {
+            printf(" %s=not ready", names[r]);
+            continue;
+        }
+        if (at > last) last = at;
+        printf(" %s=%.1fms", names[r], (double)(at - launchNs) / 1e6);
+    }
+    printf(", party=%.1fms\n", last ? (double)(last - launchNs) / 1e6 : -1.0);
+    fflush(stdout);
+}
+
+// Fresh levers for the treasure room: a count left over from an earlier run would open the
+// door by itself, so any old ones are unlinked first. Also creates /SpoilsReady (count 0), which
+// the rogue posts and the barbarian waits on; the launcher itself never uses it.
+static void open_levers(sem_t **lever1, sem_t **lever2) {
+    const struct DungeonNames *names = dungeon_names();
+    sem_unlink(names->leverOne);
+    sem_unlink(names->leverTwo);
+    sem_unlink(names->spoilsReady);
+    *lever1 = sem_open(names->leverOne, O_CREAT, 0666, 1);
+    *lever2 = sem_open(names->leverTwo, O_CREAT, 0666, 1);
+    sem_t *spoils = sem_open(names->spoilsReady, O_CREAT, 0666, 0);
+    if (*lever1 == SEM_FAILED || *lever2 == SEM_FAILED || spoils == SEM_FAILED) {
+        perror("sem_open");
+        exit(1);
+    }
+    sem_close(spoils); // stays alive by name until close_levers()
+}
+
+static void close_levers(sem_t *lever1, sem_t *lever2) {
+    if (lever1 && lever1 != SEM_FAILED) sem_close(lever1);
+    if (lever2 && lever2 != SEM_FAILED) sem_close(lever2);
+    sem_unlink(dungeon_names()->leverOne);
+    sem_unlink(dungeon_names()->leverTwo);
+    sem_unlink(dungeon_names()->spoilsReady);
+}
+
+// Shutdown: clear running, ring every role's doorbell and reap them until timeoutMs. The roles
+// see the ring, unmap and exit on their own; only roles that miss the deadline get SIGKILL.
+// pids[r] <= 0 is skipped. Prints the teardown latency as `who`.
+static void stop_roles(const char *who, struct Dungeon *d, pid_t pids[NUM_ROLES], int timeoutMs) {
+    uint64_t start = dungeon_now_ns();
+    uint64_t deadline = start + (uint64_t)timeoutMs * 1000000ull;
+
+    trace_event(g_trace, TRACE_MARK, TRACE_TEARDOWN);
+    dungeon_set_running(d, false);
+    int pidfds[NUM_ROLES];
+    for (int r = 0; r < NUM_ROLES; ++r) {
+        pidfds[r] = -1;
+        if (pids[r] <= 0) continue;
+        doorbell_ring(d, r, DOORBELL_SHUTDOWN);
+        pidfds[r] = (int)syscall(SYS_pidfd_open, pids[r], 0); // -1 on kernels before 5.3
+    }
+
+    int left = 0;
+    for (int r = 0; r < NUM_ROLES; ++r) {
+        if (pids[r] > 0) ++left;
+    }
+    while (left > 0) {
+        for (int r = 0; r < NUM_ROLES; ++r) {
+            if (pids[r] > 0 && waitpid(pids[r], NULL, WNOHANG) == pids[r]) {
+                pids[r] = 0;
+                --left;
+            }
+        }
+        uint64_t now = dungeon_now_ns();
+        if (left == 0 || now >= deadline) break;
+
+        // sleep until a role exits (its pidfd becomes readable); without pidfds, poll every ms
+        struct pollfd pfds[NUM_ROLES];
+        nfds_t n = 0;
+        for (int r = 0; r < NUM_ROLES; ++r) {
+            if (pids[r] > 0 && pidfds[r] >= 0) {
+                pfds[n].fd = pidfds[r];
+                pfds[n].events = POLLIN;
+                ++n;
+            }
+        }
+        int waitMs = (int)((deadline - now + 999999ull) / 1000000ull);
+        if ((int)n < left && waitMs > 1) waitMs = 1;
+        poll(pfds, n, waitMs);
+    }
+
+    int killed = 0;
+    for (int r = 0; r < NUM_ROLES; ++r) {
+        if (pids[r] > 0) { // missed the deadline
+            kill(pids[r], SIGKILL);
+            waitpid(pids[r], NULL, 0);
+            pids[r] = 0;
+            ++killed;
+        }
+        if (pidfds[r] >= 0) close(pidfds[r]);
+    }
+    printf("[%s] teardown: roles reaped in %.1fms, %d killed after the %dms deadline\n",
+           who, (double)(dungeon_now_ns() - start) / 1e6, killed, timeoutMs);
+    fflush(stdout);
+}
+
+// Undo create_shared_dungeon(): close the doorbells and our descriptor, unmap and unlink.
+static void destroy_shared_dungeon(struct Dungeon *d) {
+    dungeon_stats_destroy(g_dungeon_stats);
+    g_dungeon_stats = NULL;
+    dungeon_trace_destroy(g_dungeon_trace); // saved to the DUNGEON_TRACE file
+    g_dungeon_trace = NULL;
+    g_trace = NULL;
+    doorbell_close(d);
+    munmap(d, sizeof(struct Dungeon));
+    if (g_dungeon_shm_fd >= 0) close(g_dungeon_shm_fd);
+    g_dungeon_shm_fd = -1;
+    unsetenv(DUNGEON_SHM_FD_ENV);
+    shm_unlink(dungeon_names()->shm);
+}
+#endif
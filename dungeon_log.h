@@ -0,0 +1,185 @@
+#ifndef DUNGEON_LOG_H
+#define DUNGEON_LOG_H
+//Binary log of a dungeon run, read back by dungeon_replay. Two writers make it:
+//  - the local dungeon (dungeon_driver -o), as it publishes each round's inputs and judges the
+//    round, so every round is in the log with its exact reaction time
+//  - dungeon_record, which polls the prebuilt game's struct Dungeon for changes. It misses
+//    rounds that come and go within one poll, and its times are poll times, so header.pollNs
+//    marks the log and the replay does not report reaction times from it
+//The file is mapped and grows in DUNGEON_LOG_CHUNK steps; every record is a 16-byte head with a
+//timestamp, a kind and one value, followed by its text (spells, treasure) padded to 8 bytes.
+//header.bytes is stored with release after each record, so a reader can follow a log that is
+//still being written.
+//Files that include this need _DEFAULT_SOURCE (or _GNU_SOURCE).
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define DUNGEON_LOG_MAGIC (0x474f4c44u) //"DLOG"
+#define DUNGEON_LOG_VERSION (2u)
+#define DUNGEON_LOG_CHUNK ((size_t)1 << 20)
+
+enum DungeonLogKind{
+	LOG_RUNNING = 1,  //value: the running flag
+	LOG_HEALTH = 2,   //value: enemy.health
+	LOG_SPELL = 3,    //text: barrier.spell
+	LOG_TRAP = 4,     //value: trap.direction | trap.locked << 8
+	LOG_TREASURE = 5, //text: the four treasure bytes
+	LOG_RING = 6,     //role, value: doorbell rings since the last record
+	LOG_SIGNAL = 7,   //role, value: signals the role read since the last record (dungeon_stats.h)
+	LOG_ATTACK = 8,   //value: barbarian.attack
+	LOG_PICK = 9,     //value: rogue.pick, the bits of the float
+	LOG_DECODED = 10, //text: wizard.spell
+	LOG_SPOILS = 11,  //text: the four spoils bytes
+	LOG_TARGET = 12,  //local dungeon: value: the angle that opens the trap, the bits of the float
+	LOG_JUDGED = 13   //local dungeon: value: the round's number (its place among the logged rounds,
+	                  //from 0), role: 1 if the party beat it
+};
+
+struct DungeonLogHeader{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t startNs;       //dungeon_now_ns() at the start; records hold offsets from it
+	_Atomic uint64_t bytes; //record bytes after the header
+	uint64_t records;
+	uint64_t pollNs;        //dungeon_record's poll interval; 0 if the local dungeon wrote the log
+	uint64_t reserved[3];
+};
+
+struct DungeonLogRecord{
+	uint64_t tNs;  //since startNs
+	uint8_t kind;
+	uint8_t role;  //LOG_RING, LOG_SIGNAL and LOG_JUDGED
+	uint16_t len;  //bytes of text after the record
+	int32_t value;
+};
+
+_Static_assert(sizeof(struct DungeonLogHeader) == 64, "log header changed size");
+_Static_assert(sizeof(struct DungeonLogRecord) == 16, "log record changed size");
+
+static inline size_t dungeon_log_record_size(uint16_t len){
+	return sizeof(struct DungeonLogRecord) + (((size_t)len + 7) & ~(size_t)7);
+}
+
+static inline const char *dungeon_log_text(const struct DungeonLogRecord *r){
+	return (const char *)(r + 1);
+}
+
+struct DungeonLogWriter{
+	int fd;
+	uint8_t *base;
+	size_t size; //mapped (and file) size
+	size_t used; //header plus records
+	struct DungeonLogHeader *hdr;
+};
+
+static inline int dungeon_log_map(struct DungeonLogWriter *w, size_t size){
+	if (ftruncate(w->fd, (off_t)size) == -1) return -1;
+	void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, w->fd, 0);
+	if (p == MAP_FAILED) return -1;
+	if (w->base) munmap(w->base, w->size);
+	w->base = p;
+	w->size = size;
+	w->hdr = (struct DungeonLogHeader *)p;
+	return 0;
+}
+
+//Create (or truncate) path; pollNs as in the header. Returns -1 with errno set on failure.
+static inline int dungeon_log_create(struct DungeonLogWriter *w, const char *path, uint64_t startNs, uint64_t pollNs){
+	memset(w, 0, sizeof(*w));
+	w->fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (w->fd == -1) return -1;
+	if (dungeon_log_map(w, DUNGEON_LOG_CHUNK) == -1) {
+		close(w->fd);
+		return -1;
+	}
+	w->hdr->magic = DUNGEON_LOG_MAGIC;
+	w->hdr->version = DUNGEON_LOG_VERSION;
+	w->hdr->startNs = startNs;
+	w->hdr->pollNs = pollNs;
+	w->used = sizeof(struct DungeonLogHeader);
+	return 0;
+}
+
+static inline int dungeon_log_append(struct DungeonLogWriter *w, uint64_t nowNs, enum DungeonLogKind kind,
+                                     int role, int32_t value, const void *text, uint16_t len){
+	size_t n = dungeon_log_record_size(len);
+	if (w->used + n > w->size && dungeon_log_map(w, w->size + DUNGEON_LOG_CHUNK) == -1) return -1;
+	struct DungeonLogRecord *r = (struct DungeonLogRecord *)(w->base + w->used);
+	r->tNs = nowNs - w->hdr->startNs;
+	r->kind = (uint8_t)kind;
+	r->role = (uint8_t)role;
+	r->len = len;
+	r->value = value;
+	if (len) {
+		memcpy(r + 1, text, len);
+		memset((char *)(r + 1) + len, 0, n - sizeof(*r) - len);
+	}
+	w->used += n;
+	w->hdr->records++;
+	atomic_store_explicit(&w->hdr->bytes, w->used - sizeof(struct DungeonLogHeader), memory_order_release);
+	return 0;
+}
+
+//Cut the file to what was written and unmap it.
+static inline void dungeon_log_finish(struct DungeonLogWriter *w){
+	if (!w->base) return;
+	size_t used = w->used;
+	munmap(w->base, w->size);
+	int rc = ftruncate(w->fd, (off_t)used); //on failure the tail is zeros past header.bytes
+	(void)rc;
+	close(w->fd);
+	w->base = NULL;
+}
+
+struct DungeonLog{
+	const uint8_t *base;
+	size_t size;
+	const struct DungeonLogHeader *hdr;
+};
+
+//Map a log read-only. Returns -1 if it cannot be opened or is not a log.
+static inline int dungeon_log_open(struct DungeonLog *log, const char *path){
+	memset(log, 0, sizeof(*log));
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) return -1;
+	struct stat st;
+	if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(struct DungeonLogHeader)) {
+		close(fd);
+		return -1;
+	}
+	void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) return -1;
+	log->base = p;
+	log->size = (size_t)st.st_size;
+	log->hdr = p;
+	if (log->hdr->magic != DUNGEON_LOG_MAGIC || log->hdr->version != DUNGEON_LOG_VERSION) {
+		munmap(p, log->size);
+		return -1;
+	}
+	return 0;
+}
+
+//Record at *offset (0 for the first), advancing *offset past it; NULL at the end.
+static inline const struct DungeonLogRecord *dungeon_log_next(const struct DungeonLog *log, size_t *offset){
+	size_t end = sizeof(struct DungeonLogHeader) + atomic_load_explicit(&log->hdr->bytes, memory_order_acquire);
+	if (end > log->size) end = log->size;
+	size_t at = sizeof(struct DungeonLogHeader) + *offset;
+	if (at + sizeof(struct DungeonLogRecord) > end) return NULL;
+	const struct DungeonLogRecord *r = (const struct DungeonLogRecord *)(log->base + at);
+	size_t n = dungeon_log_record_size(r->len);
+	if (at + n > end) return NULL;
+	*offset += n;
+	return r;
+}
+
+static inline void dungeon_log_close(struct DungeonLog *log){
+	if (log->base) munmap((void *)log->base, log->size);
+	log->base = NULL;
+}
+#endif
@@ -0,0 +1,74 @@
+#ifndef DUNGEON_NAMES_H
+#define DUNGEON_NAMES_H
+//Names of the shared objects of one dungeon instance. With DUNGEON_INSTANCE unset they are the
+//names in dungeon_info.h, which the prebuilt RunDungeon() also uses. With DUNGEON_INSTANCE=x
+//every name gets a ".x" suffix (/DungeonMem.x, /LeverOne.x, ...), so several local dungeons
+//(dungeon_driver under dungeon_supervisor) can share a host without clobbering each other.
+//The launcher and its roles see the same variable, since the roles inherit its environment.
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dungeon_info.h"
+
+#define DUNGEON_INSTANCE_ENV "DUNGEON_INSTANCE"
+#define DUNGEON_INSTANCE_MAX (32)
+#define DUNGEON_NAME_MAX (64)
+
+struct DungeonNames{
+	char instance[DUNGEON_INSTANCE_MAX]; //"" for the default instance
+	char shm[DUNGEON_NAME_MAX];
+	char leverOne[DUNGEON_NAME_MAX];
+	char leverTwo[DUNGEON_NAME_MAX];
+	char spoilsReady[DUNGEON_NAME_MAX];
+	char trace[DUNGEON_NAME_MAX];
+};
+
+//Instance names end up in /dev/shm file names, so only letters, digits, '-' and '_'.
+static inline bool dungeon_instance_valid(const char *instance){
+	size_t n = strlen(instance);
+	if (n == 0 || n >= DUNGEON_INSTANCE_MAX) return false;
+	for (size_t i = 0; i < n; ++i) {
+		char c = instance[i];
+		bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+		          c == '-' || c == '_';
+		if (!ok) return false;
+	}
+	return true;
+}
+
+static inline void dungeon_instance_name(char *out, const char *base, const char *instance){
+	if (*instance) {
+		snprintf(out, DUNGEON_NAME_MAX, "%s.%s", base, instance);
+	} else {
+		snprintf(out, DUNGEON_NAME_MAX, "%s", base);
+	}
+}
+
+//The names for this process, worked out from DUNGEON_INSTANCE on first use. An invalid
+//instance is reported once and the default names are used.
+static inline const struct DungeonNames *dungeon_names(void){
+	static struct DungeonNames names;
+	static bool done = false;
+	if (done) return &names;
+
+	const char *env = getenv(DUNGEON_INSTANCE_ENV);
+	names.instance[0] = '\0';
+	if (env && *env) {
+		if (dungeon_instance_valid(env)) {
+			snprintf(names.instance, sizeof(names.instance), "%s", env);
+		} else {
+			fprintf(stderr, "%s=%s is not a valid instance name, using the default names\n",
+			        DUNGEON_INSTANCE_ENV, env);
+		}
+	}
+	dungeon_instance_name(names.shm, dungeon_shm_name, names.instance);
+	dungeon_instance_name(names.leverOne, dungeon_lever_one, names.instance);
+	dungeon_instance_name(names.leverTwo, dungeon_lever_two, names.instance);
+	dungeon_instance_name(names.spoilsReady, dungeon_spoils_ready, names.instance);
+	dungeon_instance_name(names.trace, dungeon_trace_name, names.instance);
+	done = true;
+	return &names;
+}
+#endif
@@ -0,0 +1,93 @@
+#ifndef DUNGEON_QUEUE_H
+#define DUNGEON_QUEUE_H
+//Helpers for the command queues (struct RoleQueue in dungeon_info.h), which live in the queues
+//extension of /DungeonMem (dungeon_segment.h), or in anonymous memory for the party.
+//The dungeon is the only producer of commands and the only consumer of completions, the role
+//the other way round, so every counter has one writer: a batch is written into its slots and
+//published with one release store of the counter, and taken with one acquire load of it.
+//The dungeon never has more than QUEUE_DEPTH commands out (posted - reaped), so the completion
+//ring can not overflow and the role never has to wait for room.
+//Files that include this need _DEFAULT_SOURCE (or _GNU_SOURCE).
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "dungeon_info.h"
+#include "dungeon_clock.h"
+#include "dungeon_segment.h"
+
+enum QueueCommandType{
+	QUEUE_ATTACK = 1, //barbarian: write value to barbarian.attack
+	QUEUE_DECODE = 2  //wizard: decode the spell record at ref in place
+};
+
+#define QUEUE_STATUS_DONE (0)
+#define QUEUE_STATUS_UNKNOWN (1)
+
+//Map the queues of the running dungeon, launcher and roles alike. NULL without them.
+static inline struct DungeonQueues *dungeon_queues_open(void){
+	return dungeon_extension_open(DUNGEON_EXT_QUEUES, sizeof(struct DungeonQueues), true);
+}
+
+static inline void dungeon_queues_close(struct DungeonQueues *qs){
+	dungeon_extension_close(qs, sizeof(*qs));
+}
+
+//NULL for no queues.
+static inline struct RoleQueue *dungeon_queue(struct DungeonQueues *qs, enum DungeonRole role){
+	return qs ? &qs->role[role] : NULL;
+}
+
+//Dungeon: commands that can be posted before a completion is reaped.
+static inline uint32_t queue_room(struct RoleQueue *q){
+	uint32_t posted = atomic_load_explicit(&q->posted, memory_order_relaxed);
+	return QUEUE_DEPTH - (posted - atomic_load_explicit(&q->reaped, memory_order_relaxed));
+}
+
+//Dungeon: queue up to n commands, stamped with the time. Returns how many fit.
+static inline uint32_t queue_post(struct RoleQueue *q, struct QueueCommand *cmds, uint32_t n){
+	uint32_t room = queue_room(q);
+	if (n > room) n = room;
+	uint32_t posted = atomic_load_explicit(&q->posted, memory_order_relaxed);
+	uint64_t now = dungeon_now_ns();
+	for (uint32_t i = 0; i < n; ++i) {
+		cmds[i].postedNs = now;
+		q->command[(posted + i) & (QUEUE_DEPTH - 1)] = cmds[i];
+	}
+	atomic_store_explicit(&q->posted, posted + n, memory_order_release); //slots land first
+	return n;
+}
+
+//Role: copy out up to max waiting commands and free their slots.
+static inline uint32_t queue_take(struct RoleQueue *q, struct QueueCommand *out, uint32_t max){
+	uint32_t taken = atomic_load_explicit(&q->taken, memory_order_relaxed);
+	uint32_t n = atomic_load_explicit(&q->posted, memory_order_acquire) - taken;
+	if (n > max) n = max;
+	for (uint32_t i = 0; i < n; ++i) {
+		out[i] = q->command[(taken + i) & (QUEUE_DEPTH - 1)];
+	}
+	atomic_store_explicit(&q->taken, taken + n, memory_order_release);
+	return n;
+}
+
+//Role: publish n completions. Always fits, see above.
+static inline void queue_complete(struct RoleQueue *q, const struct QueueCompletion *done, uint32_t n){
+	uint32_t completed = atomic_load_explicit(&q->completed, memory_order_relaxed);
+	for (uint32_t i = 0; i < n; ++i) {
+		q->completion[(completed + i) & (QUEUE_DEPTH - 1)] = done[i];
+	}
+	atomic_store_explicit(&q->completed, completed + n, memory_order_release);
+}
+
+//Dungeon: copy out up to max completions, which gives their commands' room back.
+static inline uint32_t queue_reap(struct RoleQueue *q, struct QueueCompletion *out, uint32_t max){
+	uint32_t reaped = atomic_load_explicit(&q->reaped, memory_order_relaxed);
+	uint32_t n = atomic_load_explicit(&q->completed, memory_order_acquire) - reaped;
+	if (n > max) n = max;
+	for (uint32_t i = 0; i < n; ++i) {
+		out[i] = q->completion[(reaped + i) & (QUEUE_DEPTH - 1)];
+	}
+	atomic_store_explicit(&q->reaped, reaped + n, memory_order_release);
+	return n;
+}
+#endif
@@ -0,0 +1,217 @@
+// dungeon_record.c
+// Records the prebuilt game into a binary log (dungeon_log.h): the
+// dungeon's inputs (health, barrier spell, trap, treasure), the notices the roles got (doorbell
+// rings, and signals as counted in the stats extension) and the roles' answers (attack, pick, decoded
+// spell, spoils), each with its time. dungeon_replay plays the log back against the roles.
+//   dungeon_record [-i instance] [-p poll_us] [-o file]
+// Start it before or alongside the game; it stops when the dungeon stops running.
+// The fields are polled, since the prebuilt dungeon writes them without telling anyone, so a
+// change that is undone within one poll interval is not seen, and the log is marked as polled:
+// its times are when a poll saw a change, not when it happened. The local dungeon logs its own
+// rounds exactly (dungeon_driver -o), so record that one with -o instead.
+
+#define _DEFAULT_SOURCE // shm_open(), setenv()
+
+#include <errno.h> // EINTR
+#include <signal.h> // sigaction()
+#include <stdio.h> // printf()
+#include <stdlib.h> // atol()
+#include <string.h> // memcmp()
+#include <time.h> // nanosleep()
+#include <unistd.h> // getopt()
+#include <sys/mman.h> // munmap()
+
+#include "dungeon_info.h" // struct Dungeon
+#include "dungeon_atomic.h" // field accessors
+#include "dungeon_attach.h" // dungeon_attach()
+#include "dungeon_clock.h" // dungeon_now_ns()
+#include "dungeon_log.h" // the log format
+#include "dungeon_names.h" // DUNGEON_INSTANCE_ENV
+#include "dungeon_stats.h" // signals read by each role
+
+#define RECORD_START_TIMEOUT_MS (10000) // how long to wait for a dungeon to start running
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void on_interrupt(int sig) {
+    (void)sig;
+    g_stop = 1;
+}
+
+// Everything the recorder compares between polls
+struct Snapshot {
+    bool running;
+    int health;
+    char spell[SPELL_BUFFER_SIZE + 1];
+    int trap; // direction | locked << 8
+    char treasure[4];
+    uint32_t rings[NUM_ROLES];
+    uint64_t signals[NUM_ROLES];
+    int attack;
+    float pick;
+    char decoded[SPELL_BUFFER_SIZE];
+    char spoils[4];
+};
+
+static void snapshot(struct Dungeon *d, const struct DungeonStats *stats, struct Snapshot *s) {
+    s->running = dungeon_running(d);
+    s->health = dungeon_load_health(d);
+    dungeon_read_barrier(d, s->spell);
+    s->trap = (unsigned char)dungeon_load_direction(d) | (dungeon_trap_locked(d) ? 1 << 8 : 0);
+    dungeon_read_treasure(d, s->treasure);
+    for (int r = 0; r < NUM_ROLES; ++r) {
+        s->rings[r] = atomic_load_explicit(&d->doorbell.generation[r], memory_order_relaxed);
+        s->signals[r] = stats ? atomic_load_explicit(&stats->role[r].signals, memory_order_relaxed) : 0;
+    }
+    s->attack = dungeon_load_attack(d);
+    s->pick = dungeon_load_pick(d);
+    dungeon_seq_copy(s->decoded, d->wizard.spell, sizeof(s->decoded)); // single writer, no seqlock
+    for (int i = 0; i < 4; ++i) {
+        s->spoils[i] = dungeon_load_spoil(d, i);
+    }
+}
+
+// Text bytes to keep: up to and including the terminator
+static uint16_t text_len(const char *text, size_t size) {
+    size_t n = strnlen(text, size);
+    return (uint16_t)(n < size ? n + 1 : size);
+}
+
+// Append a record for every field that differs between was and now; all of them if first.
+static void record_changes(struct DungeonLogWriter *w, uint64_t t, const struct Snapshot *was,
+                           const struct Snapshot *now, bool first) {
+    if (first || now->running != was->running) {
+        dungeon_log_append(w, t, LOG_RUNNING, 0, now->running, NULL, 0);
+    }
+    if (first || now->health != was->health) {
+        dungeon_log_append(w, t, LOG_HEALTH, 0, now->health, NULL, 0);
+    }
+    if (first || memcmp(now->spell, was->spell, sizeof(now->spell)) != 0) {
+        dungeon_log_append(w, t, LOG_SPELL, 0, 0, now->spell, text_len(now->spell, sizeof(now->spell)));
+    }
+    if (first || now->trap != was->trap) {
+        dungeon_log_append(w, t, LOG_TRAP, 0, now->trap, NULL, 0);
+    }
+    if (first || memcmp(now->treasure, was->treasure, 4) != 0) {
+        dungeon_log_append(w, t, LOG_TREASURE, 0, 0, now->treasure, 4);
+    }
+    for (int r = 0; r < NUM_ROLES; ++r) {
+        if (!first && now->rings[r] != was->rings[r]) {
+            dungeon_log_append(w, t, LOG_RING, r, (int32_t)(now->rings[r] - was->rings[r]), NULL, 0);
+        }
+        if (!first && now->signals[r] != was->signals[r]) {
+            dungeon_log_append(w, t, LOG_SIGNAL, r, (int32_t)(now->signals[r] - was->signals[r]), NULL, 0);
+        }
+    }
+    if (first || now->attack != was->attack) {
+        dungeon_log_append(w, t, LOG_ATTACK, 0, now->attack, NULL, 0);
+    }
+    if (first || memcmp(&now->pick, &was->pick, sizeof(now->pick)) != 0) {
+        int32_t bits;
+        memcpy(&bits, &now->pick, sizeof(bits));
+        dungeon_log_append(w, t, LOG_PICK, 0, bits, NULL, 0);
+    }
+    if (first || memcmp(now->decoded, was->decoded, sizeof(now->decoded)) != 0) {
+        dungeon_log_append(w, t, LOG_DECODED, 0, 0, now->decoded, text_len(now->decoded, sizeof(now->decoded)));
+    }
+    if (first || memcmp(now->spoils, was->spoils, 4) != 0) {
+        dungeon_log_append(w, t, LOG_SPOILS, 0, 0, now->spoils, 4);
+    }
+}
+
+static void pause_us(long us) {
+    struct timespec ts = { .tv_sec = us / 1000000L, .tv_nsec = (us % 1000000L) * 1000L };
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR && !g_stop) {
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-i instance] [-p poll_us] [-o file]\n"
+            "  -i  the dungeon started with DUNGEON_INSTANCE=instance\n"
+            "  -p  how often the shared memory is looked at (default 50us)\n"
+            "  -o  log file (default dungeon.dlog)\n",
+            prog);
+}
+
+int main(int argc, char **argv) {
+    const char *path = "dungeon.dlog";
+    long pollUs = 50;
+    int opt;
+    while ((opt = getopt(argc, argv, "i:p:o:")) != -1) {
+        switch (opt) {
+        case 'i': setenv(DUNGEON_INSTANCE_ENV, optarg, 1); break; // read by dungeon_names()
+        case 'p': pollUs = atol(optarg); break;
+        case 'o': path = optarg; break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if (pollUs <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    unsetenv(DUNGEON_SHM_FD_ENV); // not one of the launcher's roles
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_interrupt;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    // look for the segment every poll, not every 100ms like dungeon_attach(), so a recorder
+    // started just before the game does not miss the first round
+    uint64_t giveUp = dungeon_now_ns() + (uint64_t)RECORD_START_TIMEOUT_MS * 1000000ull;
+    int fd = -1;
+    while (fd == -1 && !g_stop && dungeon_now_ns() < giveUp) {
+        fd = shm_open(dungeon_names()->shm, O_RDONLY, 0);
+        if (fd == -1) pause_us(pollUs);
+    }
+    if (fd != -1) close(fd);
+    struct Dungeon *d = dungeon_attach("dungeon_record");
+    if (!d) return 1;
+
+    // a segment left over from an earlier run is not running yet: wait for the launcher's reset
+    while (!dungeon_running(d) && !g_stop && dungeon_now_ns() < giveUp) {
+        pause_us(pollUs);
+    }
+    if (!dungeon_running(d)) {
+        fprintf(stderr, "dungeon_record: %s is not running\n", dungeon_names()->shm);
+        munmap(d, sizeof(*d));
+        return 1;
+    }
+    struct DungeonStats *stats = dungeon_stats_open(false); // NULL: no signal counts
+
+    struct DungeonLogWriter w;
+    uint64_t start = dungeon_now_ns();
+    if (dungeon_log_create(&w, path, start, (uint64_t)pollUs * 1000ull) == -1) {
+        perror(path);
+        return 1;
+    }
+
+    static struct Snapshot a;
+    static struct Snapshot b;
+    struct Snapshot *was = &a;
+    struct Snapshot *now = &b;
+    snapshot(d, stats, was);
+    record_changes(&w, start, was, was, true);
+    uint64_t polls = 1;
+    while (!g_stop && was->running) {
+        pause_us(pollUs);
+        snapshot(d, stats, now);
+        record_changes(&w, dungeon_now_ns(), was, now, false);
+        struct Snapshot *t = was;
+        was = now;
+        now = t;
+        ++polls;
+    }
+
+    uint64_t records = w.hdr->records;
+    size_t bytes = w.used;
+    double secs = (double)(dungeon_now_ns() - start) / 1e9;
+    dungeon_log_finish(&w);
+    dungeon_stats_close(stats);
+    munmap(d, sizeof(*d));
+    printf("[Record] %llu records (%.1f KiB) from %llu polls over %.1f s to %s\n",
+           (unsigned long long)records, (double)bytes / 1024.0, (unsigned long long)polls, secs, path);
+    return 0;
+}
@@ -0,0 +1,306 @@
+// dungeon_replay.c
+// Plays a log from dungeon_driver -o or dungeon_record back against the unmodified role binaries: the recorded
+// health values, spells, trap angles and treasures become rounds of the local dungeon
+// (local_dungeon.c), started at their recorded times or back to back with -f. Prints the
+// replay's report next to the reaction times of the recorded run, so a slow or failed round can
+// be run again without the prebuilt dungeon and its timing.
+//   dungeon_replay [-f] [-t] [-s] [-v] log
+
+#define _DEFAULT_SOURCE // POSIX plus syscall() for the doorbell futex
+
+#include <errno.h> // EINTR
+#include <stdio.h> // printf()
+#include <stdlib.h> // calloc()
+#include <string.h> // memcpy()
+#include <time.h> // nanosleep()
+#include <unistd.h> // getopt()
+#include <semaphore.h> // levers
+
+#include "dungeon_info.h" // shared memory struct and semaphore names
+#include "dungeon_launch.h" // create_shared_dungeon(), start_process(), stop_roles()
+#include "dungeon_log.h" // the log format
+#include "local_dungeon.h" // the round engine
+#include "spell_decode.h" // the answer to a recorded barrier
+
+struct ReplayRound {
+    struct RoundInput in;
+    uint64_t startNs; // offset in the recording
+    uint64_t reactionNs; // recorded time to the answer
+    bool answered; // the recorded party beat it
+    bool timed; // ...and reactionNs says how fast
+    bool complete; // every input was seen (a trap needs its end for the angle)
+};
+
+struct Replay {
+    struct ReplayRound *rounds;
+    size_t count;
+    size_t cap;
+    uint64_t pollNs; // dungeon_record's poll interval, 0 for a log the local dungeon wrote
+};
+
+static struct ReplayRound *replay_add(struct Replay *rp, enum RoundType type, uint64_t t) {
+    if (rp->count == rp->cap) {
+        size_t cap = rp->cap ? rp->cap * 2 : 256;
+        struct ReplayRound *grown = realloc(rp->rounds, cap * sizeof(*grown));
+        if (!grown) return NULL;
+        rp->rounds = grown;
+        rp->cap = cap;
+    }
+    struct ReplayRound *r = &rp->rounds[rp->count++];
+    memset(r, 0, sizeof(*r));
+    r->in.type = type;
+    r->startNs = t;
+    r->complete = type != ROUND_TRAP && type != ROUND_TREASURE;
+    return r;
+}
+
+// Turn the log back into rounds. In a log of the local dungeon every input record starts a
+// round and LOG_JUDGED ends it. In a polled one a round starts where its input changes (the first
+// record of each field is the state before the run), and its recorded reaction ends at the first
+// answer that beats it; a barrier whose plaintext is already in wizard.spell (the same phrase
+// twice in a row) counts as beaten, with no reaction time.
+static void replay_build(struct Replay *rp, const struct DungeonLog *log) {
+    bool polled = rp->pollNs != 0;
+    bool seen[LOG_SPOILS + 1] = { false };
+    long monster = -1, barrier = -1, trap = -1, treasure = -1; // open rounds, by index
+    bool locked = false;
+    float pick = 0.0f;
+    char lastTreasure[4] = { 0 };
+    char lastDecoded[SPELL_BUFFER_SIZE] = { 0 };
+
+    size_t offset = 0;
+    const struct DungeonLogRecord *rec;
+    while ((rec = dungeon_log_next(log, &offset)) != NULL) {
+        const char *text = dungeon_log_text(rec);
+        bool first = polled && rec->kind <= LOG_SPOILS && !seen[rec->kind];
+        if (rec->kind <= LOG_SPOILS) seen[rec->kind] = true;
+        struct ReplayRound *r;
+
+        switch (rec->kind) {
+        case LOG_HEALTH:
+            if (first || !(r = replay_add(rp, ROUND_MONSTER, rec->tNs))) break;
+            r->in.health = rec->value;
+            monster = (long)(rp->count - 1);
+            break;
+        case LOG_ATTACK:
+            if (monster >= 0 && rec->value == rp->rounds[monster].in.health) {
+                rp->rounds[monster].reactionNs = rec->tNs - rp->rounds[monster].startNs;
+                rp->rounds[monster].answered = rp->rounds[monster].timed = true;
+                monster = -1;
+            }
+            break;
+        case LOG_SPELL:
+            if (first || rec->len < 2 || text[0] == '\0') break;
+            if (!(r = replay_add(rp, ROUND_BARRIER, rec->tNs))) break;
+            memcpy(r->in.spell, text, rec->len < sizeof(r->in.spell) ? rec->len : sizeof(r->in.spell) - 1);
+            spell_decode(r->in.answer, sizeof(r->in.answer), r->in.spell, sizeof(r->in.spell));
+            barrier = (long)(rp->count - 1);
+            if (polled && strcmp(lastDecoded, r->in.answer) == 0) {
+                r->answered = true; // no change to see
+                barrier = -1;
+            }
+            break;
+        case LOG_DECODED:
+            snprintf(lastDecoded, sizeof(lastDecoded), "%.*s", (int)rec->len, text);
+            if (barrier >= 0 && strcmp(lastDecoded, rp->rounds[barrier].in.answer) == 0) {
+                rp->rounds[barrier].reactionNs = rec->tNs - rp->rounds[barrier].startNs;
+                rp->rounds[barrier].answered = rp->rounds[barrier].timed = true;
+                barrier = -1;
+            }
+            break;
+        case LOG_PICK: {
+            int32_t bits = rec->value;
+            memcpy(&pick, &bits, sizeof(pick));
+            break;
+        }
+        case LOG_TRAP: {
+            bool nowLocked = (rec->value >> 8) & 1;
+            if (nowLocked && (!polled || (!first && !locked)) && (r = replay_add(rp, ROUND_TRAP, rec->tNs))) {
+                trap = (long)(rp->count - 1);
+            } else if (!nowLocked && locked && trap >= 0) {
+                r = &rp->rounds[trap];
+                r->in.target = pick; // the lock opened here, so this pick was within the threshold
+                r->complete = true;
+                if ((char)(rec->value & 0xff) == '-') {
+                    r->reactionNs = rec->tNs - r->startNs;
+                    r->answered = r->timed = true;
+                }
+                trap = -1;
+            }
+            locked = nowLocked;
+            break;
+        }
+        case LOG_TREASURE:
+            if ((!polled || (!first && lastTreasure[0] == '\0' && text[0] != '\0')) &&
+                (r = replay_add(rp, ROUND_TREASURE, rec->tNs))) {
+                treasure = (long)(rp->count - 1);
+            }
+            if (treasure >= 0) {
+                r = &rp->rounds[treasure];
+                memcpy(r->in.treasure, text, 4);
+                r->complete = text[0] && text[1] && text[2] && text[3];
+            }
+            memcpy(lastTreasure, text, 4);
+            break;
+        case LOG_SPOILS:
+            if (treasure >= 0 && rp->rounds[treasure].complete &&
+                memcmp(text, rp->rounds[treasure].in.treasure, 4) == 0) {
+                rp->rounds[treasure].reactionNs = rec->tNs - rp->rounds[treasure].startNs;
+                rp->rounds[treasure].answered = rp->rounds[treasure].timed = true;
+                treasure = -1;
+            }
+            break;
+        case LOG_TARGET:
+            if (trap >= 0) {
+                int32_t bits = rec->value;
+                memcpy(&rp->rounds[trap].in.target, &bits, sizeof(float));
+                rp->rounds[trap].complete = true;
+            }
+            break;
+        case LOG_JUDGED:
+            if (rec->value >= 0 && (size_t)rec->value < rp->count) {
+                r = &rp->rounds[rec->value];
+                r->answered = r->timed = rec->role != 0;
+                r->reactionNs = rec->tNs - r->startNs;
+            }
+            break;
+        default:
+            break; // rings, signals and the running flag are for reading, not replaying
+        }
+    }
+}
+
+// Reaction times of the recorded run, in the same shape as local_dungeon_report()
+static void report_recorded(const struct Replay *rp, FILE *out) {
+    uint64_t *samples = calloc(rp->count ? rp->count : 1, sizeof(*samples));
+    if (!samples) return;
+    fprintf(out, "[Replay] recorded run:\n");
+    if (rp->pollNs) {
+        // a poll sees an answer up to an interval late, or in the same poll as the input
+        fprintf(out, "  polled every %.1fus: rounds that came and went between polls are missing, "
+                "and there are no reaction times\n", (double)rp->pollNs / 1000.0);
+    }
+    for (int t = 0; t < NUM_ROUND_TYPES; ++t) {
+        unsigned attempts = 0;
+        unsigned wins = 0;
+        size_t n = 0;
+        for (size_t i = 0; i < rp->count; ++i) {
+            const struct ReplayRound *r = &rp->rounds[i];
+            if (r->in.type != (enum RoundType)t || !r->complete) continue;
+            ++attempts;
+            if (!r->answered) continue;
+            ++wins;
+            if (r->timed) samples[n++] = r->reactionNs;
+        }
+        if (attempts == 0) continue;
+        fprintf(out, "  %-8s %u/%u (%.1f%%)", local_dungeon_round_name(t), wins, attempts,
+                100.0 * (double)wins / (double)attempts);
+        if (n > 0 && !rp->pollNs) {
+            fprintf(out, "  reaction p50=%.1fus p99=%.1fus", (double)dungeon_percentile(samples, n, 50.0) / 1000.0,
+                    (double)dungeon_percentile(samples, n, 99.0) / 1000.0);
+        }
+        fprintf(out, "\n");
+    }
+    free(samples);
+}
+
+static void sleep_until(uint64_t ns) {
+    uint64_t now = dungeon_now_ns();
+    if (now >= ns) return;
+    uint64_t left = ns - now;
+    struct timespec ts = { (time_t)(left / 1000000000ull), (long)(left % 1000000000ull) };
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-f] [-t] [-s] [-v] log\n"
+            "  -f  as fast as possible: each round starts when the last one is judged\n"
+            "  -t  turbo: millisecond windows instead of the ones in dungeon_settings.h\n"
+            "  -s  notify roles with DUNGEON_SIGNAL/SEMAPHORE_SIGNAL instead of the doorbell\n"
+            "  -v  print every round\n",
+            prog);
+}
+
+int main(int argc, char **argv) {
+    bool turbo = false;
+    for (int i = 1; i < argc; ++i) {
+        if (argv[i][0] == '-' && argv[i][1] == 't') turbo = true;
+    }
+    struct LocalDungeonConfig cfg;
+    local_dungeon_defaults(&cfg, turbo);
+    bool fast = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "ftsv")) != -1) {
+        switch (opt) {
+        case 'f': fast = true; break;
+        case 't': break;
+        case 's': cfg.useSignals = true; break;
+        case 'v': cfg.verbose = true; break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    struct DungeonLog log;
+    if (dungeon_log_open(&log, argv[optind]) == -1) {
+        fprintf(stderr, "dungeon_replay: %s is not a dungeon_record log\n", argv[optind]);
+        return 1;
+    }
+    struct Replay rp = { NULL, 0, 0, log.hdr->pollNs };
+    replay_build(&rp, &log);
+    dungeon_log_close(&log);
+    if (rp.count == 0) {
+        fprintf(stderr, "dungeon_replay: no rounds in %s\n", argv[optind]);
+        return 1;
+    }
+    printf("[Replay] %zu rounds from %s, %s\n", rp.count, argv[optind],
+           fast ? "as fast as possible" : "at recorded speed");
+
+    dungeon_rt_apply("Dungeon", DUNGEON_RT_GAME); // opt-in real-time profile, see dungeon_rt.h
+    uint64_t launchNs = dungeon_now_ns();
+    struct Dungeon *d = create_shared_dungeon(0);
+    d->dungeonPID = getpid();
+
+    sem_t *lever1;
+    sem_t *lever2;
+    open_levers(&lever1, &lever2);
+
+    pid_t pids[NUM_ROLES];
+    pids[ROLE_BARBARIAN] = start_process("barbarian", "./barbarian");
+    pids[ROLE_WIZARD]    = start_process("wizard",    "./wizard");
+    pids[ROLE_ROGUE]     = start_process("rogue",     "./rogue");
+    if (dungeon_wait_ready(d, NUM_ROLES, 5000) < NUM_ROLES) {
+        fprintf(stderr, "dungeon_replay: not every role became ready, starting anyway\n");
+    }
+    report_ready("Dungeon", d, launchNs);
+
+    struct LocalDungeon ld;
+    local_dungeon_init(&ld, d, pids, lever1, lever2, &cfg);
+    ld.startNs = dungeon_now_ns();
+    uint64_t firstNs = rp.rounds[0].startNs;
+    for (size_t i = 0; i < rp.count && dungeon_running(d); ++i) {
+        const struct ReplayRound *r = &rp.rounds[i];
+        if (!r->complete) continue; // a trap the recording ended in
+        if (!fast) sleep_until(ld.startNs + (r->startNs - firstNs)); // late rounds start at once
+        local_dungeon_play(&ld, &r->in);
+    }
+    ld.endNs = dungeon_now_ns();
+
+    stop_roles("Dungeon", d, pids, 3000);
+
+    report_recorded(&rp, stdout);
+    printf("[Replay] replayed:\n");
+    local_dungeon_report(&ld, stdout);
+    local_dungeon_free(&ld);
+    free(rp.rounds);
+
+    close_levers(lever1, lever2);
+    destroy_shared_dungeon(d);
+    return 0;
+}
@@ -0,0 +1,122 @@
+#ifndef DUNGEON_RT_H
+#define DUNGEON_RT_H
+//Opt-in real-time profile for the game, the driver and the roles, configured from the environment:
+//  DUNGEON_RT=1              turn it on: pin to a core, mlockall(), prefault the struct Dungeon mapping
+//  DUNGEON_RT_CPUS=g,w,r,b   cores for the game/driver, wizard, rogue and barbarian (-1 = don't pin);
+//                            default: game on 0, each role on the next core, wrapping around
+//  DUNGEON_RT_FIFO=prio      also run under SCHED_FIFO at this priority (1-99). Without the
+//                            permission for it, falls back to nice -10, then to the normal scheduler.
+//Everything is best effort: a step that fails is reported and the process carries on.
+//Files that include this need _DEFAULT_SOURCE (or _GNU_SOURCE).
+#include <ctype.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "dungeon_info.h"
+
+//Slot of the launcher in DUNGEON_RT_CPUS, after the roles.
+#define DUNGEON_RT_GAME (NUM_ROLES)
+
+static inline bool dungeon_rt_enabled(void){
+	const char *e = getenv("DUNGEON_RT");
+	return e && *e && strcmp(e, "0") != 0;
+}
+
+//Prefault a fresh mapping of the shared struct Dungeon in real-time mode, so the first access
+//in a timed window never takes a page fault, and report whether that worked. Called where the
+//mapping is made: dungeon_rt_apply() runs before it exists.
+static inline void dungeon_rt_prefault(const char *who, void *addr, size_t len){
+	if (!dungeon_rt_enabled()) return;
+	char tag[32]; //"barbarian" from dungeon_attach() reports as [Barbarian], like dungeon_rt_apply()
+	snprintf(tag, sizeof(tag), "%s", who);
+	tag[0] = (char)toupper((unsigned char)tag[0]);
+#ifdef MADV_POPULATE_WRITE
+	if (madvise(addr, len, MADV_POPULATE_WRITE) == 0) {
+		printf("[%s] real-time: %zu-byte mapping prefaulted\n", tag, len);
+		fflush(stdout);
+		return;
+	}
+	if (errno != EINVAL) {
+		printf("[%s] real-time: prefault failed (%s)\n", tag, strerror(errno));
+		fflush(stdout);
+		return;
+	}
+#endif
+	//kernels before 5.14: read a byte of every page instead
+	long page = sysconf(_SC_PAGESIZE);
+	if (page < 1) page = 4096;
+	for (size_t off = 0; off < len; off += (size_t)page) {
+		(void)((volatile const char *)addr)[off];
+	}
+	printf("[%s] real-time: %zu-byte mapping prefaulted by reading it\n", tag, len);
+	fflush(stdout);
+}
+
+//DUNGEON_RT_CPUS lists the game first, then the roles in enum DungeonRole order.
+static inline int dungeon_rt_cpu(int slot){
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	if (ncpu < 1) ncpu = 1;
+	int field = slot == DUNGEON_RT_GAME ? 0 : slot + 1;
+
+	const char *list = getenv("DUNGEON_RT_CPUS");
+	if (!list || !*list) return (int)(field % ncpu);
+	for (int i = 0; i < field && list; ++i) {
+		list = strchr(list, ',');
+		if (list) ++list;
+	}
+	if (!list || *list == ',' || *list == '\0') return -1; //not listed: don't pin
+	return atoi(list);
+}
+
+//Apply the profile to the calling process. who is the prefix of the one-line report.
+static inline void dungeon_rt_apply(const char *who, int slot){
+	if (!dungeon_rt_enabled()) return;
+	char report[256];
+	int len = snprintf(report, sizeof(report), "[%s] real-time:", who);
+
+	int cpu = dungeon_rt_cpu(slot);
+	if (cpu >= 0 && cpu < 1024) {
+		unsigned long mask[1024 / (8 * sizeof(unsigned long))];
+		memset(mask, 0, sizeof(mask));
+		mask[cpu / (8 * sizeof(unsigned long))] |= 1ul << (cpu % (8 * sizeof(unsigned long)));
+		//raw syscall: sched_setaffinity() and cpu_set_t would need _GNU_SOURCE
+		bool ok = syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask) == 0;
+		len += snprintf(report + len, sizeof(report) - len, " cpu %d%s", cpu, ok ? "" : " (pin failed)");
+	} else {
+		len += snprintf(report + len, sizeof(report) - len, " unpinned");
+	}
+
+	const char *fifo = getenv("DUNGEON_RT_FIFO");
+	if (fifo && *fifo) {
+		struct sched_param sp;
+		memset(&sp, 0, sizeof(sp));
+		sp.sched_priority = atoi(fifo);
+		int rc = sched_setscheduler(0, SCHED_FIFO, &sp);
+		int err = errno;
+		if (rc == 0) {
+			len += snprintf(report + len, sizeof(report) - len, ", SCHED_FIFO %d", sp.sched_priority);
+		} else if (setpriority(PRIO_PROCESS, 0, -10) == 0) {
+			len += snprintf(report + len, sizeof(report) - len, ", SCHED_FIFO denied (%s), nice -10",
+			                strerror(err));
+		} else {
+			len += snprintf(report + len, sizeof(report) - len, ", SCHED_FIFO and nice denied");
+		}
+	}
+
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) {
+		len += snprintf(report + len, sizeof(report) - len, ", memory locked");
+	} else {
+		len += snprintf(report + len, sizeof(report) - len, ", mlockall failed (%s)", strerror(errno));
+	}
+	printf("%s\n", report);
+	fflush(stdout);
+}
+#endif
@@ -0,0 +1,252 @@
+#ifndef DUNGEON_RUNTIME_H
+#define DUNGEON_RUNTIME_H
+//Event loop shared by the role processes. Each role blocks in epoll_wait() on:
+//  - a signalfd for DUNGEON_SIGNAL, SEMAPHORE_SIGNAL and the shutdown signals (SIGTERM, SIGINT)
+//  - its doorbell eventfd, inherited from the game
+//  - a pidfd of the game, readable once the game process is gone
+//so an idle role costs no wakeups at all and reacts as soon as the kernel schedules it.
+//If signalfd/epoll cannot be set up, or the role has no eventfd (it was started by hand), it
+//falls back to signal handlers that ring the doorbell plus a futex wait on it (dungeon_doorbell.h).
+//Files that include this need _DEFAULT_SOURCE (or _GNU_SOURCE).
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/prctl.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+
+#include "dungeon_info.h"
+#include "dungeon_settings.h"
+#include "dungeon_doorbell.h"
+#include "dungeon_clock.h"
+#include "dungeon_stats.h"
+#include "dungeon_trace.h"
+
+struct RoleRuntime{
+	struct Dungeon *dungeon;
+	enum DungeonRole role;
+	int epollFd;   //-1 when running on the fallback path
+	int signalFd;
+	int bellFd;    //inherited doorbell eventfd, -1 if none (then epollFd is -1 too)
+	int parentFd;  //pidfd of the game in the epoll set, -1 if none (then PR_SET_PDEATHSIG)
+	uint32_t bellSeen;
+	uint64_t startNs;
+	uint64_t wakeNs;     //when the current event was picked up
+	uint64_t wakeups;    //returns from the blocking wait, including spurious ones
+	uint64_t events;     //wakeups that carried work
+	struct LatencyStats ringToWake; //doorbell ring -> role running
+	struct LatencyStats handling;   //role running -> role_runtime_done()
+	uint64_t ringNs;                //when the current event was rung (wakeNs for plain signals)
+	struct DungeonStats *statsSegment; //live metrics (dungeon_stats.h), NULL without one
+	struct RoleStats *stats;        //this role's block in it
+	struct DungeonTrace *traceSegment; //event rings (dungeon_trace.h), NULL unless tracing
+	struct TraceRing *trace;        //this role's ring in it
+};
+
+//Used by the fallback handler, which can't be given an argument.
+static struct Dungeon *g_runtime_dungeon = NULL;
+static enum DungeonRole g_runtime_role = ROLE_WIZARD;
+
+static inline void role_runtime_fallback_handler(int sig){
+	if (!g_runtime_dungeon) return;
+	if (sig == DUNGEON_SIGNAL) {
+		doorbell_ring(g_runtime_dungeon, g_runtime_role, DOORBELL_ENCOUNTER);
+	} else if (sig == SEMAPHORE_SIGNAL) {
+		doorbell_ring(g_runtime_dungeon, g_runtime_role, DOORBELL_SEMAPHORE);
+	} else {
+		doorbell_ring(g_runtime_dungeon, g_runtime_role, DOORBELL_SHUTDOWN);
+	}
+}
+
+static inline void role_runtime_signals(sigset_t *set){
+	sigemptyset(set);
+	sigaddset(set, DUNGEON_SIGNAL);
+	sigaddset(set, SEMAPHORE_SIGNAL);
+	sigaddset(set, SIGTERM);
+	sigaddset(set, SIGINT);
+}
+
+//Set up the event loop for one role. Returns 0, or -1 if even the fallback could not be installed.
+static inline int role_runtime_open(struct RoleRuntime *rt, struct Dungeon *d, enum DungeonRole role){
+	memset(rt, 0, sizeof(*rt));
+	rt->dungeon = d;
+	rt->role = role;
+	rt->epollFd = -1;
+	rt->signalFd = -1;
+	rt->parentFd = -1;
+	rt->bellFd = doorbell_attach(d, role);
+	rt->bellSeen = atomic_load(&d->doorbell.generation[role]);
+	rt->startNs = dungeon_now_ns();
+	rt->statsSegment = dungeon_stats_open(true);
+	rt->stats = dungeon_stats_role(rt->statsSegment, role);
+	rt->traceSegment = dungeon_trace_open();
+	rt->trace = dungeon_trace_ring(rt->traceSegment, role);
+
+	sigset_t set;
+	role_runtime_signals(&set);
+	//without the eventfd, a ring that comes without a signal (a queued command, a ring from the
+	//supervisor) only moves the futex word, which epoll cannot see
+	if (rt->bellFd >= 0 && sigprocmask(SIG_BLOCK, &set, NULL) == 0) {
+		rt->signalFd = signalfd(-1, &set, SFD_CLOEXEC);
+		rt->epollFd = epoll_create1(EPOLL_CLOEXEC);
+	}
+	if (rt->signalFd >= 0 && rt->epollFd >= 0) {
+		struct epoll_event ev = { .events = EPOLLIN, .data.fd = rt->signalFd };
+		int ok = epoll_ctl(rt->epollFd, EPOLL_CTL_ADD, rt->signalFd, &ev) == 0;
+		if (ok) {
+			ev.data.fd = rt->bellFd;
+			ok = epoll_ctl(rt->epollFd, EPOLL_CTL_ADD, rt->bellFd, &ev) == 0;
+		}
+		if (ok) {
+			//shut down with the game instead of blocking forever. The pidfd follows the game
+			//process; PR_SET_PDEATHSIG follows the thread that spawned us, and replacements are
+			//spawned by the supervisor's watcher thread (dungeon_supervise.h), which ends first.
+			rt->parentFd = (int)syscall(SYS_pidfd_open, getppid(), 0); //-1 on kernels before 5.3
+			ev.data.fd = rt->parentFd;
+			if (rt->parentFd >= 0 && epoll_ctl(rt->epollFd, EPOLL_CTL_ADD, rt->parentFd, &ev) == -1) {
+				close(rt->parentFd);
+				rt->parentFd = -1;
+			}
+			if (rt->parentFd < 0) prctl(PR_SET_PDEATHSIG, SIGTERM);
+			return 0;
+		}
+	}
+
+	//fallback: handlers ring our own doorbell, the loop waits on its futex
+	if (rt->bellFd < 0) {
+		fprintf(stderr, "role runtime: no doorbell eventfd from the game, using signal handlers\n");
+	} else {
+		perror("role runtime: signalfd/epoll unavailable, using signal handlers");
+	}
+	if (rt->signalFd >= 0) close(rt->signalFd);
+	if (rt->epollFd >= 0) close(rt->epollFd);
+	rt->signalFd = -1;
+	rt->epollFd = -1;
+	sigprocmask(SIG_UNBLOCK, &set, NULL);
+	prctl(PR_SET_PDEATHSIG, SIGTERM); //shut down with the game instead of blocking forever
+
+	g_runtime_dungeon = d;
+	g_runtime_role = role;
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = role_runtime_fallback_handler;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+	int rc = 0;
+	if (sigaction(DUNGEON_SIGNAL, &sa, NULL) == -1) rc = -1;
+	if (sigaction(SEMAPHORE_SIGNAL, &sa, NULL) == -1) rc = -1;
+	if (sigaction(SIGTERM, &sa, NULL) == -1) rc = -1;
+	if (sigaction(SIGINT, &sa, NULL) == -1) rc = -1;
+	return rc;
+}
+
+//Turn one signal read from the signalfd into DOORBELL_* bits.
+static inline uint32_t role_runtime_signal_bits(uint32_t signo){
+	if ((int)signo == DUNGEON_SIGNAL) return DOORBELL_ENCOUNTER;
+	if ((int)signo == SEMAPHORE_SIGNAL) return DOORBELL_SEMAPHORE;
+	return DOORBELL_SHUTDOWN;
+}
+
+//Block until there is something to do (timeoutMs = -1 waits forever).
+//Returns DOORBELL_* bits, or 0 on timeout.
+static inline uint32_t role_runtime_wait(struct RoleRuntime *rt, int timeoutMs){
+	struct Dungeon *d = rt->dungeon;
+	uint32_t bits = 0;
+
+	uint64_t rungAt = 0;
+
+	if (rt->epollFd < 0) {
+		bits = doorbell_wait(d, rt->role, &rt->bellSeen, rt->bellFd, timeoutMs);
+		rt->wakeups++;
+		if (bits) {
+			rungAt = atomic_load(&d->doorbell.rungAtNs[rt->role]);
+			trace_event(rt->trace, TRACE_RING, bits);
+		}
+	} else {
+		while (bits == 0) {
+			struct epoll_event evs[3];
+			int n = epoll_wait(rt->epollFd, evs, 3, timeoutMs);
+			rt->wakeups++;
+			if (n == -1 && errno == EINTR) continue;
+			if (n <= 0) break; //timeout or error
+
+			for (int i = 0; i < n; ++i) {
+				if (evs[i].data.fd == rt->signalFd) {
+					struct signalfd_siginfo si[8];
+					ssize_t got = read(rt->signalFd, si, sizeof(si));
+					for (ssize_t k = 0; k < got / (ssize_t)sizeof(si[0]); ++k) {
+						bits |= role_runtime_signal_bits(si[k].ssi_signo);
+						trace_event(rt->trace, TRACE_SIGNAL, si[k].ssi_signo);
+					}
+					if (rt->stats && got > 0) stat_add(&rt->stats->signals, (uint64_t)got / sizeof(si[0]));
+				} else if (evs[i].data.fd == rt->parentFd) {
+					bits |= DOORBELL_SHUTDOWN; //the game is gone
+				} else {
+					uint64_t count;
+					ssize_t got = read(rt->bellFd, &count, sizeof(count)); //drain the eventfd
+					(void)got;
+				}
+			}
+			//rings also carry their reason in the doorbell, whichever way they arrived
+			rt->bellSeen = atomic_load_explicit(&d->doorbell.generation[rt->role], memory_order_acquire);
+			uint32_t rung = doorbell_take(d, rt->role);
+			if (rung) {
+				rungAt = atomic_load(&d->doorbell.rungAtNs[rt->role]);
+				trace_event(rt->trace, TRACE_RING, rung);
+			}
+			bits |= rung;
+		}
+	}
+
+	rt->wakeNs = dungeon_now_ns();
+	rt->ringNs = rt->wakeNs;
+	if (rungAt) {
+		rt->ringNs = rungAt;
+		latency_record(&rt->ringToWake, rt->wakeNs - rungAt);
+		if (rt->stats) {
+			stat_add(&rt->stats->rings, 1);
+			stat_record(rt->stats, METRIC_WAKE, rt->wakeNs - rungAt);
+		}
+	}
+	if (bits) {
+		rt->events++;
+		if (rt->stats) stat_add(&rt->stats->events, 1);
+	}
+	return bits;
+}
+
+//Call when the work for the last event is finished, to record how long the role took.
+static inline void role_runtime_done(struct RoleRuntime *rt){
+	uint64_t now = dungeon_now_ns();
+	latency_record(&rt->handling, now - rt->wakeNs);
+	stat_record(rt->stats, METRIC_REACTION, now - rt->ringNs);
+}
+
+static inline void role_runtime_report(const struct RoleRuntime *rt, const char *who){
+	double secs = (double)(dungeon_now_ns() - rt->startNs) / 1e9;
+	printf("[%s] wakeups: %llu (%.2f/s), events: %llu, loop: %s\n", who,
+	       (unsigned long long)rt->wakeups, secs > 0 ? (double)rt->wakeups / secs : 0.0,
+	       (unsigned long long)rt->events, rt->epollFd >= 0 ? "epoll" : "futex");
+	latency_print(who, "doorbell ring to wake", &rt->ringToWake);
+	latency_print(who, "wake to done", &rt->handling);
+	fflush(stdout);
+}
+
+static inline void role_runtime_close(struct RoleRuntime *rt){
+	if (rt->signalFd >= 0) close(rt->signalFd);
+	if (rt->epollFd >= 0) close(rt->epollFd);
+	if (rt->parentFd >= 0) close(rt->parentFd);
+	rt->signalFd = -1;
+	rt->epollFd = -1;
+	rt->parentFd = -1;
+	dungeon_stats_close(rt->statsSegment);
+	rt->statsSegment = NULL;
+	rt->stats = NULL;
+	dungeon_trace_close(rt->traceSegment);
+	rt->traceSegment = NULL;
+	rt->trace = NULL;
+}
+#endif
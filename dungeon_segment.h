@@ -0,0 +1,190 @@
+#ifndef DUNGEON_SEGMENT_H
+#define DUNGEON_SEGMENT_H
+//Layout of /DungeonMem. struct Dungeon stays at offset 0, where the prebuilt RunDungeon() maps
+//it, and keeps to its first page. A versioned header sits on the next page, and the bulky parts
+//(command queues, live stats, the large-spell arena) follow as extensions at aligned offsets:
+//
+//  0                      struct Dungeon        hot, mapped by every role
+//  DUNGEON_HEADER_OFFSET  struct DungeonHeader  magic, ABI version, sizes, extension table
+//  DUNGEON_SEGMENT_ALIGN  extension 0           e.g. struct DungeonQueues
+//  ...                    extension n
+//
+//A process maps only the extensions it uses, each as its own window (dungeon_extension_open()),
+//and tmpfs gives the segment pages only when they are first touched, so an extension nobody uses
+//costs neither memory nor address space. A role built for another layout or ABI is
+//refused at attach instead of reading the wrong bytes.
+//Files that include this need _DEFAULT_SOURCE (or _GNU_SOURCE).
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "dungeon_info.h"
+#include "dungeon_names.h"
+
+#define DUNGEON_SHM_FD_ENV "DUNGEON_SHM_FD" //the launcher's descriptor for /DungeonMem, see dungeon_attach.h
+#define DUNGEON_SEGMENT_MAGIC (0x4d474e44u) //"DNGM"
+#define DUNGEON_ABI_VERSION (1u)
+#define DUNGEON_HEADER_OFFSET ((size_t)4096)
+#define DUNGEON_SEGMENT_ALIGN ((size_t)65536) //a multiple of every page size Linux uses
+#define DUNGEON_MAX_EXTENSIONS (8)
+
+#ifdef DUNGEON_PARTITIONED_LAYOUT
+#define DUNGEON_LAYOUT (1u)
+#else
+#define DUNGEON_LAYOUT (0u)
+#endif
+
+_Static_assert(sizeof(struct Dungeon) <= DUNGEON_HEADER_OFFSET, "struct Dungeon grew past its page");
+
+enum DungeonExtensionType{
+	DUNGEON_EXT_QUEUES = 1, //struct DungeonQueues (dungeon_queue.h)
+	DUNGEON_EXT_STATS = 2,  //struct DungeonStats (dungeon_stats.h)
+	DUNGEON_EXT_SPELLS = 3  //struct SpellArena (spell_arena.h), only in large-spell mode
+};
+
+struct DungeonExtension{
+	uint32_t type;   //enum DungeonExtensionType
+	uint32_t flags;  //none yet
+	uint64_t offset; //from the segment start, a multiple of DUNGEON_SEGMENT_ALIGN
+	uint64_t length;
+};
+
+struct DungeonHeader{
+	uint32_t magic;
+	uint32_t abiVersion;
+	uint32_t headerSize;     //sizeof(struct DungeonHeader)
+	uint32_t dungeonSize;    //sizeof(struct Dungeon)
+	uint32_t layout;         //DUNGEON_LAYOUT of the launcher
+	uint32_t extensionCount;
+	uint64_t segmentSize;    //what the launcher truncated /DungeonMem to
+	struct DungeonExtension extension[DUNGEON_MAX_EXTENSIONS];
+};
+
+static inline size_t dungeon_segment_round(size_t n){
+	return (n + DUNGEON_SEGMENT_ALIGN - 1) & ~(DUNGEON_SEGMENT_ALIGN - 1);
+}
+
+//Launcher: start a header for a segment with no extensions yet.
+static inline void dungeon_segment_layout(struct DungeonHeader *h){
+	*h = (struct DungeonHeader){
+		.magic = DUNGEON_SEGMENT_MAGIC,
+		.abiVersion = DUNGEON_ABI_VERSION,
+		.headerSize = sizeof(struct DungeonHeader),
+		.dungeonSize = sizeof(struct Dungeon),
+		.layout = DUNGEON_LAYOUT,
+		.segmentSize = DUNGEON_SEGMENT_ALIGN,
+	};
+}
+
+//Launcher: place an extension of length bytes at the end. Returns false if the table is full.
+static inline bool dungeon_segment_add(struct DungeonHeader *h, enum DungeonExtensionType type, size_t length){
+	if (length == 0) return true; //nothing to place
+	if (h->extensionCount >= DUNGEON_MAX_EXTENSIONS) return false;
+	h->extension[h->extensionCount++] = (struct DungeonExtension){
+		.type = (uint32_t)type,
+		.offset = h->segmentSize,
+		.length = length,
+	};
+	h->segmentSize += dungeon_segment_round(length);
+	return true;
+}
+
+//Read and check the header of the segment behind fd. Returns NULL if it is fine, else why not.
+static inline const char *dungeon_segment_read(int fd, struct DungeonHeader *h){
+	h->magic = 0;
+	if (pread(fd, h, sizeof(*h), (off_t)DUNGEON_HEADER_OFFSET) != (ssize_t)sizeof(*h)) return "has no header";
+	if (h->magic != DUNGEON_SEGMENT_MAGIC) return "has no header";
+	if (h->abiVersion != DUNGEON_ABI_VERSION) return "has another ABI version";
+	if (h->layout != DUNGEON_LAYOUT) return "uses the other struct Dungeon layout";
+	if (h->dungeonSize != sizeof(struct Dungeon) || h->headerSize != sizeof(*h)) return "has another struct Dungeon";
+	if (h->extensionCount > DUNGEON_MAX_EXTENSIONS) return "has a broken extension table";
+	return NULL;
+}
+
+static inline const struct DungeonExtension *dungeon_segment_find(const struct DungeonHeader *h,
+                                                                  enum DungeonExtensionType type){
+	for (uint32_t i = 0; i < h->extensionCount; ++i) {
+		if (h->extension[i].type == (uint32_t)type) return &h->extension[i];
+	}
+	return NULL;
+}
+
+//Returns the inherited descriptor, or -1 if there is none or it is not a big enough segment.
+static inline int dungeon_inherited_fd(void){
+	const char *env = getenv(DUNGEON_SHM_FD_ENV);
+	if (!env || !*env) return -1;
+	char *end = NULL;
+	long fd = strtol(env, &end, 10);
+	if (*end != '\0' || fd < 0 || fd > INT_MAX) return -1;
+
+	//the number may be stale (the variable leaks into anything the role starts), so check
+	//that it really is the dungeon segment
+	char path[64];
+	char link[128];
+	char want[128];
+	snprintf(path, sizeof(path), "/proc/self/fd/%ld", fd);
+	snprintf(want, sizeof(want), "/dev/shm%s", dungeon_names()->shm);
+	ssize_t n = readlink(path, link, sizeof(link) - 1);
+	if (n <= 0) return -1;
+	link[n] = '\0';
+	if (strcmp(link, want) != 0) return -1;
+
+	struct stat st;
+	if (fstat((int)fd, &st) == -1 || st.st_size < (off_t)sizeof(struct Dungeon)) return -1;
+	return (int)fd;
+}
+
+//Descriptor for /DungeonMem: the inherited one if there is one, else a fresh one the caller
+//closes (*owned). -1 if the dungeon is not running.
+static inline int dungeon_segment_fd(bool writable, bool *owned){
+	int fd = dungeon_inherited_fd();
+	*owned = fd == -1;
+	return *owned ? shm_open(dungeon_names()->shm, writable ? O_RDWR : O_RDONLY, 0) : fd;
+}
+
+//Bytes of an extension of the running dungeon, 0 if it has none.
+static inline size_t dungeon_extension_length(enum DungeonExtensionType type){
+	bool owned;
+	int fd = dungeon_segment_fd(false, &owned);
+	if (fd == -1) return 0;
+	struct DungeonHeader h;
+	const struct DungeonExtension *e = NULL;
+	if (!dungeon_segment_read(fd, &h)) e = dungeon_segment_find(&h, type);
+	if (owned) close(fd);
+	return e ? (size_t)e->length : 0;
+}
+
+//Map the first length bytes of an extension, read-only unless writable. NULL if the dungeon is
+//not running, has no such extension, or a shorter one than the caller's struct. Undo with
+//dungeon_extension_close() and the same length.
+static inline void *dungeon_extension_open(enum DungeonExtensionType type, size_t length, bool writable){
+	bool owned;
+	int fd = dungeon_segment_fd(writable, &owned);
+	if (fd == -1) return NULL;
+	struct DungeonHeader h;
+	void *p = NULL;
+	const struct DungeonExtension *e = NULL;
+	if (!dungeon_segment_read(fd, &h)) e = dungeon_segment_find(&h, type);
+	struct stat st;
+	//past the end of the file the window would fault on first touch
+	if (e && e->length >= length && e->offset % (uint64_t)sysconf(_SC_PAGESIZE) == 0 && fstat(fd, &st) == 0 &&
+	    (uint64_t)st.st_size >= e->offset + length) {
+		p = mmap(NULL, length, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, (off_t)e->offset);
+		if (p == MAP_FAILED) p = NULL;
+	}
+	if (owned) close(fd);
+	return p;
+}
+
+static inline void dungeon_extension_close(void *p, size_t length){
+	if (p) munmap(p, length);
+}
+#endif
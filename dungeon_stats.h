@@ -0,0 +1,124 @@
+#ifndef DUNGEON_STATS_H
+#define DUNGEON_STATS_H
+//Live metrics in the stats extension of /DungeonMem (dungeon_segment.h), laid out by the launcher
+//(create_shared_dungeon()) and read by dungeonstat while the game runs.
+//Each role owns one cache-line-aligned block of counters and log2 histograms (the same buckets
+//as struct LatencyStats) and is the only writer of it, so an update is a relaxed load and a
+//relaxed store per word: no locked instruction and no cache line shared with another role.
+//Everything here is a no-op on a NULL block, so a role without the segment runs unchanged.
+//Files that include this need _DEFAULT_SOURCE (or _GNU_SOURCE).
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "dungeon_info.h"
+#include "dungeon_clock.h"
+#include "dungeon_segment.h"
+
+#define DUNGEON_STATS_MAGIC (0x44535441u) //"DSTA"
+#define DUNGEON_STATS_VERSION (2u)
+
+enum RoleMetric{
+	METRIC_WAKE = 0,       //doorbell ring -> role running
+	METRIC_REACTION = 1,   //doorbell ring (or signal pickup) -> role done with the event
+	METRIC_DECODE = 2,     //wizard: barrier snapshot + decode
+	METRIC_PICK_TICKS = 3, //rogue: dungeon ticks until the lock opened (a count, not ns)
+	METRIC_LEVER_HOLD = 4, //barbarian: levers pulled -> levers posted
+	METRIC_TREASURE = 5,   //rogue: treasure signal -> all spoils copied
+	METRIC_ATTACK = 6,     //barbarian: health published -> attack committed (local dungeon only)
+	NUM_ROLE_METRICS = 7
+};
+
+struct StatHistogram{
+	_Atomic uint64_t count;
+	_Atomic uint64_t total;
+	_Atomic uint64_t max;
+	_Atomic uint64_t buckets[LATENCY_BUCKETS];
+};
+
+struct RoleStats{
+	alignas(DUNGEON_CACHE_LINE) _Atomic int32_t pid; //0 until the role attaches
+	_Atomic uint64_t signals; //signals read from the signalfd
+	_Atomic uint64_t rings;   //doorbell rings picked up
+	_Atomic uint64_t events;  //wakeups that carried work
+	struct StatHistogram metric[NUM_ROLE_METRICS];
+};
+
+struct DungeonStats{
+	uint32_t magic;
+	uint32_t version;
+	_Atomic uint32_t live; //cleared by the launcher before it unlinks the segment
+	uint64_t startNs;
+	struct RoleStats role[NUM_ROLES];
+};
+
+static const char *const dungeon_metric_names[NUM_ROLE_METRICS] = {
+	"wake", "reaction", "decode", "pick ticks", "lever hold", "treasure", "attack"
+};
+
+//Single writer: plain load + store instead of an atomic read-modify-write.
+static inline void stat_add(_Atomic uint64_t *c, uint64_t v){
+	atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + v, memory_order_relaxed);
+}
+
+static inline void stat_record(struct RoleStats *s, enum RoleMetric m, uint64_t v){
+	if (!s) return;
+	struct StatHistogram *h = &s->metric[m];
+	stat_add(&h->buckets[latency_bucket(v)], 1);
+	stat_add(&h->total, v);
+	if (v > atomic_load_explicit(&h->max, memory_order_relaxed)) {
+		atomic_store_explicit(&h->max, v, memory_order_relaxed);
+	}
+	//last and release, so a reader that loads count with acquire sees at least that many bucket hits
+	atomic_store_explicit(&h->count, atomic_load_explicit(&h->count, memory_order_relaxed) + 1,
+	                      memory_order_release);
+}
+
+//Launcher: map and stamp the extension once /DungeonMem is laid out. Returns NULL on failure;
+//the game runs without it.
+static inline struct DungeonStats *dungeon_stats_create(void){
+	struct DungeonStats *s = dungeon_extension_open(DUNGEON_EXT_STATS, sizeof(*s), true);
+	if (!s) return NULL;
+	memset(s, 0, sizeof(*s));
+	s->magic = DUNGEON_STATS_MAGIC;
+	s->version = DUNGEON_STATS_VERSION;
+	s->startNs = dungeon_now_ns();
+	atomic_store_explicit(&s->live, 1, memory_order_release);
+	return s;
+}
+
+//Map the extension of the running dungeon, read-only for viewers. Returns NULL if it is missing
+//or not ours.
+static inline struct DungeonStats *dungeon_stats_open(bool writable){
+	struct DungeonStats *s = dungeon_extension_open(DUNGEON_EXT_STATS, sizeof(*s), writable);
+	if (!s) return NULL;
+	if (s->magic != DUNGEON_STATS_MAGIC || s->version != DUNGEON_STATS_VERSION) {
+		dungeon_extension_close(s, sizeof(*s));
+		return NULL;
+	}
+	return s;
+}
+
+//Role: its own block, stamped with its pid, or NULL without a segment.
+static inline struct RoleStats *dungeon_stats_role(struct DungeonStats *s, enum DungeonRole role){
+	if (!s) return NULL;
+	atomic_store_explicit(&s->role[role].pid, (int32_t)getpid(), memory_order_relaxed);
+	return &s->role[role];
+}
+
+static inline void dungeon_stats_close(struct DungeonStats *s){
+	dungeon_extension_close(s, sizeof(*s));
+}
+
+//Launcher: mark the run finished and unmap; the extension goes with /DungeonMem.
+static inline void dungeon_stats_destroy(struct DungeonStats *s){
+	if (!s) return;
+	atomic_store_explicit(&s->live, 0, memory_order_release);
+	dungeon_stats_close(s);
+}
+#endif
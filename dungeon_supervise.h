@@ -0,0 +1,339 @@
+#ifndef DUNGEON_SUPERVISE_H
+#define DUNGEON_SUPERVISE_H
+//Crash supervision for the role processes, used by game.c and the local dungeon driver.
+//A thread watches each role's pidfd. When a role exits while the dungeon is still running it is
+//replaced, by its hot standby (DUNGEON_STANDBY=1) or by a fresh spawn, and the replacement maps
+//the existing struct Dungeon through the inherited descriptor and marks itself ready.
+//The crashed pid is only reaped at the end: the dungeon keeps signalling the pid it was given,
+//and a zombie swallows those signals where a recycled pid could be some other process. With
+//relay on, the launcher's own kill() calls (the prebuilt dungeon's too) go through __wrap_kill()
+//below, and each signal meant for a role that is gone becomes a ring of its doorbell instead.
+//The wrapper only reads atomics, so kill() never waits on the watcher: a signal sent between a
+//role's exit and the watcher waking on its pidfd goes to the zombie and is lost with the role.
+//Programs that include this link with -Wl,--wrap=kill.
+//Files that include this need _DEFAULT_SOURCE (or _GNU_SOURCE).
+#include <pthread.h> // the watcher thread
+#include <sys/eventfd.h> // stop descriptor
+
+#include "dungeon_launch.h" // start_process_env(), stop_roles()
+
+#define SUPERVISE_ENV "DUNGEON_RESPAWN" // 0 turns supervision off
+#define SUPERVISE_STANDBY_ENV "DUNGEON_STANDBY" // 1 keeps a pre-started standby per role
+#define SUPERVISE_READY_TIMEOUT_MS (2000) // replacement start-up, same order as the first one
+#define SUPERVISE_POLL_MS (1) // how often a replacement's readiness is looked at
+#define SUPERVISE_MAX_CRASHES (16) // per role; after that the role stays down
+
+static const char *const supervise_names[NUM_ROLES] = { "wizard", "rogue", "barbarian" };
+static const char *const supervise_paths[NUM_ROLES] = { "./wizard", "./rogue", "./barbarian" };
+
+// The parts of the dungeon that start a round, as last seen by the watcher (to count lost rounds)
+struct SuperviseView {
+    int health;
+    uint64_t spell; // hash of the barrier text, 0 while it is empty
+    bool locked;
+    bool treasure; // first treasure character written
+};
+
+struct SupervisedRole {
+    pid_t pid; // current process, 0 once the role is down for good
+    int pidfd;
+    pid_t standby; // promoted on the next crash, 0 if none
+    bool replaced; // pid is not the one the dungeon signals
+    pid_t crashed[SUPERVISE_MAX_CRASHES]; // exited, left as zombies until supervisor_finish()
+    _Atomic int ncrashed; // written by the watcher only; publishes crashed[] to __wrap_kill()
+};
+
+struct RoleSupervisor {
+    const char *who;
+    struct Dungeon *d;
+    bool enabled;
+    bool relay; // the dungeon notifies roles by pid (game, driver -s)
+    bool useStandby;
+    struct SupervisedRole roles[NUM_ROLES];
+    struct SuperviseView view;
+    char **standbyEnv; // environ plus DUNGEON_STANDBY_ROLE=<launcher pid>
+    char standbyVar[48];
+    int stopFd;
+    pthread_t thread;
+    struct LatencyStats recover; // exit seen -> replacement ready
+    unsigned promoted, respawned, failed, roundsLost;
+    _Atomic unsigned relayed; // counted by __wrap_kill(), from whichever thread calls kill()
+};
+
+static void supervise_view(struct Dungeon *d, struct SuperviseView *v) {
+    char spell[SPELL_BUFFER_SIZE + 1];
+    char treasure[4];
+    v->health = dungeon_load_health(d);
+    v->locked = dungeon_trap_locked(d);
+    dungeon_read_barrier(d, spell);
+    spell[SPELL_BUFFER_SIZE] = '\0';
+    v->spell = 0;
+    if (spell[0]) {
+        v->spell = 0xcbf29ce484222325ull; // FNV-1a
+        for (const char *p = spell; *p; ++p) {
+            v->spell = (v->spell ^ (unsigned char)*p) * 0x100000001b3ull;
+        }
+    }
+    dungeon_read_treasure(d, treasure);
+    v->treasure = treasure[0] != '\0';
+}
+
+// Did the rounds of `role` start between two views?
+static uint32_t supervise_round_starts(const struct SuperviseView *was, const struct SuperviseView *now,
+                                       enum DungeonRole role) {
+    uint32_t bits = 0;
+    switch (role) {
+    case ROLE_BARBARIAN: if (now->health != was->health) bits |= DOORBELL_ENCOUNTER; break;
+    case ROLE_WIZARD: if (now->spell != was->spell && now->spell != 0) bits |= DOORBELL_ENCOUNTER; break;
+    case ROLE_ROGUE: if (now->locked && !was->locked) bits |= DOORBELL_ENCOUNTER; break;
+    default: break;
+    }
+    if (role != ROLE_WIZARD && now->treasure && !was->treasure) bits |= DOORBELL_SEMAPHORE;
+    return bits;
+}
+
+// Count the rounds of `down`, a role that is being replaced right now, that started since the
+// last look.
+static void supervise_count_lost(struct RoleSupervisor *s, int down) {
+    struct SuperviseView now;
+    supervise_view(s->d, &now);
+    if (supervise_round_starts(&s->view, &now, (enum DungeonRole)down)) s->roundsLost++;
+    s->view = now;
+}
+
+// The supervisor the launcher's kill() calls are checked against, NULL when there is none
+static struct RoleSupervisor *g_supervisor = NULL;
+
+// The dungeon sent sig to pid. If pid is a role that crashed, ring the role's doorbell with what
+// the signal stands for: the replacement, ready or still starting, picks the bits up. Lock-free:
+// an entry of crashed[] is written before the release that counts it, and never changes after.
+static void supervise_forward(struct RoleSupervisor *s, pid_t pid, int sig) {
+    if (sig != DUNGEON_SIGNAL && sig != SEMAPHORE_SIGNAL) return;
+    for (int r = 0; r < NUM_ROLES; ++r) {
+        struct SupervisedRole *sr = &s->roles[r];
+        int n = atomic_load_explicit(&sr->ncrashed, memory_order_acquire);
+        for (int i = 0; i < n; ++i) {
+            if (sr->crashed[i] != pid) continue;
+            doorbell_ring(s->d, (enum DungeonRole)r, sig == SEMAPHORE_SIGNAL ? DOORBELL_SEMAPHORE : DOORBELL_ENCOUNTER);
+            atomic_fetch_add_explicit(&s->relayed, 1, memory_order_relaxed);
+            return;
+        }
+    }
+}
+
+int __real_kill(pid_t pid, int sig);
+
+int __wrap_kill(pid_t pid, int sig) {
+    struct RoleSupervisor *s = g_supervisor;
+    if (s && s->relay && pid > 0) supervise_forward(s, pid, sig);
+    return __real_kill(pid, sig);
+}
+
+static pid_t supervise_spawn(struct RoleSupervisor *s, int role, bool standby) {
+    return start_process_env(supervise_names[role], supervise_paths[role],
+                             standby ? s->standbyEnv : environ);
+}
+
+static void supervise_promote(struct RoleSupervisor *s, int role, pid_t pid) {
+    atomic_store_explicit(&s->d->standby.promote[role], (uint32_t)pid, memory_order_release);
+    doorbell_futex(&s->d->standby.promote[role], FUTEX_WAKE, INT_MAX, NULL);
+}
+
+// A role exited. Put a replacement in its place and wait until it is ready.
+static void supervise_recover(struct RoleSupervisor *s, int role) {
+    struct SupervisedRole *sr = &s->roles[role];
+    uint64_t t0 = dungeon_now_ns();
+    int ncrashed = atomic_load_explicit(&sr->ncrashed, memory_order_relaxed); // only this thread writes it
+    if (ncrashed < SUPERVISE_MAX_CRASHES) { // first thing: from here on its signals are relayed
+        sr->crashed[ncrashed] = sr->pid;
+        atomic_store_explicit(&sr->ncrashed, ncrashed + 1, memory_order_release);
+    }
+    siginfo_t si;
+    memset(&si, 0, sizeof(si));
+    waitid(P_PID, (id_t)sr->pid, &si, WEXITED | WNOHANG | WNOWAIT); // look, but leave the zombie
+    close(sr->pidfd);
+    sr->pidfd = -1;
+    if (ncrashed == SUPERVISE_MAX_CRASHES) {
+        fprintf(stderr, "[%s] %s (pid %d) exited again, giving up on it\n", s->who, supervise_names[role], sr->pid);
+        waitpid(sr->pid, NULL, 0);
+        sr->pid = 0;
+        return;
+    }
+    char how[32];
+    if (si.si_code == CLD_EXITED) snprintf(how, sizeof(how), "status %d", si.si_status);
+    else snprintf(how, sizeof(how), "signal %d", si.si_status);
+    supervise_view(s->d, &s->view); // rounds from here on are missed by this role
+
+    const char *via = "standby";
+    pid_t next = sr->standby;
+    sr->standby = 0;
+    if (next > 0) {
+        supervise_promote(s, role, next);
+        s->promoted++;
+    } else {
+        via = "respawn";
+        next = supervise_spawn(s, role, false);
+        s->respawned++;
+    }
+    sr->pid = next > 0 ? next : 0;
+    sr->replaced = true;
+    if (next <= 0) {
+        s->failed++;
+        return;
+    }
+    sr->pidfd = (int)syscall(SYS_pidfd_open, next, 0);
+
+    // ready once it has stamped a time after the crash; the futex on ready.count wakes on every mark
+    bool ready = false;
+    uint64_t deadline = t0 + (uint64_t)SUPERVISE_READY_TIMEOUT_MS * 1000000ull;
+    while (!ready && dungeon_now_ns() < deadline && dungeon_running(s->d)) {
+        uint32_t count = atomic_load_explicit(&s->d->ready.count, memory_order_acquire);
+        ready = atomic_load_explicit(&s->d->ready.readyAtNs[role], memory_order_relaxed) >= t0;
+        supervise_count_lost(s, role);
+        if (ready) break;
+        struct timespec ts = { 0, SUPERVISE_POLL_MS * 1000000L };
+        doorbell_futex(&s->d->ready.count, FUTEX_WAIT, count, &ts);
+    }
+    uint64_t took = dungeon_now_ns() - t0;
+    if (!ready) {
+        s->failed++;
+        printf("[%s] %s (pid %d) exited (%s); replacement pid %d not ready after %.1fms\n", s->who,
+               supervise_names[role], sr->crashed[ncrashed], how, next, (double)took / 1e6);
+        fflush(stdout);
+        return;
+    }
+    latency_record(&s->recover, took);
+    printf("[%s] %s (pid %d) exited (%s); %s pid %d ready in %.2fms\n", s->who, supervise_names[role],
+           sr->crashed[ncrashed], how, via, next, (double)took / 1e6);
+    fflush(stdout);
+
+    if (s->useStandby && dungeon_running(s->d)) {
+        sr->standby = supervise_spawn(s, role, true);
+        if (sr->standby < 0) sr->standby = 0;
+    }
+}
+
+static void *supervise_thread(void *arg) {
+    struct RoleSupervisor *s = arg;
+    for (;;) {
+        struct pollfd pfds[NUM_ROLES + 1];
+        int roleOf[NUM_ROLES + 1];
+        nfds_t n = 0;
+        pfds[n].fd = s->stopFd;
+        pfds[n].events = POLLIN;
+        roleOf[n++] = -1;
+        for (int r = 0; r < NUM_ROLES; ++r) {
+            if (s->roles[r].pidfd < 0) continue;
+            pfds[n].fd = s->roles[r].pidfd;
+            pfds[n].events = POLLIN;
+            roleOf[n++] = r;
+        }
+        int ready = poll(pfds, n, -1);
+        if (ready < 0 && errno != EINTR) break;
+        if (pfds[0].revents & POLLIN) break;
+        for (nfds_t i = 1; i < n && ready > 0; ++i) {
+            if (!(pfds[i].revents & POLLIN)) continue;
+            int r = roleOf[i];
+            if (!dungeon_running(s->d)) { // a normal exit at the end; stop_roles() reaps it
+                close(s->roles[r].pidfd);
+                s->roles[r].pidfd = -1;
+                continue;
+            }
+            supervise_recover(s, r);
+        }
+    }
+    return NULL;
+}
+
+// Take over the roles just started (pids by role) once they are ready. relay: the dungeon
+// notifies roles by pid, so signals for a replaced role have to be forwarded to its doorbell.
+static void supervisor_start(struct RoleSupervisor *s, const char *who, struct Dungeon *d,
+                             const pid_t pids[NUM_ROLES], bool relay) {
+    memset(s, 0, sizeof(*s));
+    s->who = who;
+    s->d = d;
+    s->relay = relay;
+    s->stopFd = -1;
+    for (int r = 0; r < NUM_ROLES; ++r) {
+        s->roles[r].pid = pids[r];
+        s->roles[r].pidfd = -1;
+    }
+    const char *env = getenv(SUPERVISE_ENV);
+    if (env && strcmp(env, "0") == 0) return;
+    env = getenv(SUPERVISE_STANDBY_ENV);
+    s->useStandby = env && strcmp(env, "1") == 0;
+
+    size_t n = 0;
+    while (environ[n]) ++n;
+    s->standbyEnv = calloc(n + 2, sizeof(char *));
+    s->stopFd = eventfd(0, EFD_CLOEXEC);
+    if (!s->standbyEnv || s->stopFd == -1) {
+        perror("supervisor");
+        return;
+    }
+    memcpy(s->standbyEnv, environ, n * sizeof(char *));
+    snprintf(s->standbyVar, sizeof(s->standbyVar), "%s=%d", DUNGEON_STANDBY_ROLE_ENV, (int)getpid());
+    s->standbyEnv[n] = s->standbyVar;
+
+    for (int r = 0; r < NUM_ROLES; ++r) {
+        s->roles[r].pidfd = (int)syscall(SYS_pidfd_open, pids[r], 0);
+        if (s->roles[r].pidfd == -1) {
+            perror("pidfd_open"); // kernels before 5.3: no supervision
+            return;
+        }
+        if (s->useStandby) {
+            pid_t pid = supervise_spawn(s, r, true);
+            s->roles[r].standby = pid > 0 ? pid : 0;
+        }
+    }
+    supervise_view(d, &s->view);
+    if (pthread_create(&s->thread, NULL, supervise_thread, s) != 0) {
+        perror("supervisor thread");
+        return;
+    }
+    s->enabled = true;
+    g_supervisor = s;
+}
+
+// The pids to stop now: the current process of each role. The watcher has been joined.
+static void supervisor_live_pids(struct RoleSupervisor *s, pid_t pids[NUM_ROLES]) {
+    for (int r = 0; r < NUM_ROLES; ++r) pids[r] = s->roles[r].pid;
+}
+
+// End of the run: stop the watcher, then the roles (stop_roles()), then let the unused
+// standbys go and reap the crashed originals. Prints a summary line if anything crashed.
+static void supervisor_finish(struct RoleSupervisor *s, int timeoutMs) {
+    g_supervisor = NULL; // the dungeon is done signalling
+    if (s->enabled) {
+        uint64_t one = 1;
+        ssize_t w = write(s->stopFd, &one, sizeof(one));
+        (void)w;
+        pthread_join(s->thread, NULL); // what it spawned watches this process, not the thread
+    }
+    pid_t pids[NUM_ROLES];
+    supervisor_live_pids(s, pids);
+    stop_roles(s->who, s->d, pids, timeoutMs); // clears running, so standbys give up below
+
+    unsigned crashes = 0;
+    for (int r = 0; r < NUM_ROLES; ++r) {
+        struct SupervisedRole *sr = &s->roles[r];
+        if (sr->standby > 0) {
+            supervise_promote(s, r, (pid_t)-1); // not its pid: it sees running == false and exits
+            waitpid(sr->standby, NULL, 0);
+        }
+        int ncrashed = atomic_load_explicit(&sr->ncrashed, memory_order_relaxed);
+        for (int i = 0; i < ncrashed; ++i) waitpid(sr->crashed[i], NULL, 0);
+        crashes += (unsigned)ncrashed;
+        if (sr->pidfd >= 0) close(sr->pidfd);
+    }
+    if (crashes > 0) {
+        printf("[%s] supervision: %u crash%s, %u from standby, %u respawned, %u failed, "
+               "%u rounds started while a role was down, %u rings relayed\n",
+               s->who, crashes, crashes == 1 ? "" : "es", s->promoted, s->respawned, s->failed,
+               s->roundsLost, atomic_load_explicit(&s->relayed, memory_order_relaxed));
+        latency_print(s->who, "time to recover", &s->recover);
+    }
+    if (s->stopFd >= 0) close(s->stopFd);
+    free(s->standbyEnv);
+}
+#endif
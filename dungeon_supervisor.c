@@ -0,0 +1,398 @@
+// dungeon_supervisor.c
+// Runs many independent parties at once to see how throughput scales with the number of parties
+// per host. Each party is a dungeon_driver (with its own barbarian, wizard and rogue processes)
+// under its own DUNGEON_INSTANCE, so their shared memory and levers never collide, pinned to its
+// own group of cores. Reports aggregate rounds/s and each party's tail latency.
+//   dungeon_supervisor [-N n[,n...]] [-u] [-v] [-- dungeon_driver options]
+// With a list for -N the runs are done one after another and summed up in a scaling table.
+
+#define _DEFAULT_SOURCE // syscall() for the affinity calls
+
+#include <errno.h> // EINTR
+#include <stdio.h> // printf()
+#include <stdlib.h> // calloc(), realloc()
+#include <string.h> // strncmp()
+#include <unistd.h> // pipe(), getopt()
+#include <fcntl.h> // FD_CLOEXEC
+#include <poll.h> // poll() on the drivers' output
+#include <spawn.h> // posix_spawn()
+#include <sys/syscall.h> // SYS_sched_getaffinity, SYS_sched_setaffinity
+#include <sys/wait.h> // waitpid()
+
+#include "dungeon_clock.h" // dungeon_now_ns()
+#include "dungeon_names.h" // DUNGEON_INSTANCE_ENV
+#include "dungeon_attach.h" // DUNGEON_SHM_FD_ENV
+
+extern char **environ;
+
+#define MAX_PARTIES (256)
+#define MAX_SWEEP (16)
+#define MAX_ROUND_TYPES (4) // monster, barrier, trap, treasure, as printed by local_dungeon_report()
+#define CPU_MASK_WORDS (1024 / (8 * sizeof(unsigned long)))
+
+static char *default_driver_args[] = { "-t", "-n", "1000", "-T", "1", NULL };
+
+struct RoundResult {
+    char name[16];
+    unsigned wins;
+    unsigned attempts;
+    double p50Us;
+    double p99Us;
+};
+
+struct PartyRun {
+    pid_t pid;
+    int outFd; // read end of the driver's stdout, -1 once it hit EOF
+    char instance[DUNGEON_INSTANCE_MAX];
+    int cpuFirst;
+    int cpuCount; // 0: not pinned
+    char *out;
+    size_t len;
+    size_t cap;
+    int status;
+    // parsed from the driver's report
+    bool reported;
+    unsigned rounds;
+    double rate;
+    struct RoundResult types[MAX_ROUND_TYPES];
+    int ntypes;
+};
+
+struct SweepResult {
+    int parties;
+    unsigned rounds;
+    double secs;
+    double rate;
+    double worstP99Us[MAX_ROUND_TYPES];
+    char typeNames[MAX_ROUND_TYPES][16];
+    int ntypes;
+    int failed;
+};
+
+// Index of a round type in a sweep's results, by name; -1 if that sweep never played it
+static int sweep_type(const struct SweepResult *r, const char *name) {
+    for (int t = 0; t < r->ntypes; ++t) {
+        if (strcmp(r->typeNames[t], name) == 0) return t;
+    }
+    return -1;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-N n[,n...]] [-u] [-v] [-- dungeon_driver options]\n"
+            "  -N  parties to run at once; a list runs one sweep per entry (default 1,2,4)\n"
+            "  -u  don't pin the parties to cores\n"
+            "  -v  print the full output of every driver\n"
+            "  driver options default to: -t -n 1000 -T 1\n",
+            prog);
+}
+
+// Raw syscalls, like dungeon_rt.h: the glibc wrappers and cpu_set_t need _GNU_SOURCE
+static bool get_affinity(unsigned long mask[CPU_MASK_WORDS]) {
+    memset(mask, 0, CPU_MASK_WORDS * sizeof(unsigned long));
+    return syscall(SYS_sched_getaffinity, 0, CPU_MASK_WORDS * sizeof(unsigned long), mask) > 0;
+}
+
+static bool set_affinity(const unsigned long mask[CPU_MASK_WORDS]) {
+    return syscall(SYS_sched_setaffinity, 0, CPU_MASK_WORDS * sizeof(unsigned long), mask) == 0;
+}
+
+// Party i of n gets an even share of the cores; with more parties than cores they wrap around
+static void party_cpus(int i, int n, int ncpu, int *first, int *count) {
+    if (n <= ncpu) {
+        *first = i * ncpu / n;
+        *count = (i + 1) * ncpu / n - *first;
+    } else {
+        *first = i % ncpu;
+        *count = 1;
+    }
+}
+
+// Our environment minus any instance or inherited segment of our own, plus entry
+// ("DUNGEON_INSTANCE=...") for the party
+static char **party_env(char *entry) {
+    size_t n = 0;
+    while (environ[n]) ++n;
+    char **env = calloc(n + 2, sizeof(*env));
+    if (!env) return NULL;
+    size_t k = 0;
+    size_t instLen = strlen(DUNGEON_INSTANCE_ENV);
+    size_t fdLen = strlen(DUNGEON_SHM_FD_ENV);
+    for (size_t i = 0; i < n; ++i) {
+        if (strncmp(environ[i], DUNGEON_INSTANCE_ENV, instLen) == 0 && environ[i][instLen] == '=') continue;
+        if (strncmp(environ[i], DUNGEON_SHM_FD_ENV, fdLen) == 0 && environ[i][fdLen] == '=') continue;
+        env[k++] = environ[i];
+    }
+    env[k++] = entry;
+    env[k] = NULL;
+    return env;
+}
+
+static int party_spawn(struct PartyRun *p, int index, char **driverArgs, int nargs, bool pin,
+                       const unsigned long saved[CPU_MASK_WORDS]) {
+    int fds[2];
+    if (pipe(fds) == -1) {
+        perror("supervisor pipe");
+        return -1;
+    }
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC); // no other party may hold our read or write end
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_adddup2(&fa, fds[1], STDOUT_FILENO); // dup2() drops FD_CLOEXEC
+
+    char seed[16];
+    snprintf(seed, sizeof(seed), "%d", index + 1); // different rounds per party unless -S is given
+    char *argv[64];
+    int argc = 0;
+    argv[argc++] = "dungeon_driver";
+    argv[argc++] = "-S";
+    argv[argc++] = seed;
+    for (int i = 0; i < nargs && argc < 63; ++i) {
+        argv[argc++] = driverArgs[i];
+    }
+    argv[argc] = NULL;
+
+    char entry[DUNGEON_INSTANCE_MAX + 32];
+    snprintf(entry, sizeof(entry), "%s=%s", DUNGEON_INSTANCE_ENV, p->instance);
+    char **env = party_env(entry);
+    if (pin && p->cpuCount > 0) {
+        unsigned long mask[CPU_MASK_WORDS];
+        memset(mask, 0, sizeof(mask));
+        for (int c = p->cpuFirst; c < p->cpuFirst + p->cpuCount; ++c) {
+            mask[c / (8 * sizeof(unsigned long))] |= 1ul << (c % (8 * sizeof(unsigned long)));
+        }
+        if (!set_affinity(mask)) p->cpuCount = 0; // the driver and its roles inherit it
+    }
+    int rc = posix_spawn(&p->pid, "./dungeon_driver", &fa, NULL, argv, env ? env : environ);
+    if (pin) set_affinity(saved);
+    posix_spawn_file_actions_destroy(&fa);
+    free(env);
+    close(fds[1]);
+    if (rc != 0) {
+        fprintf(stderr, "supervisor: posix_spawn ./dungeon_driver: %s\n", strerror(rc));
+        close(fds[0]);
+        p->pid = -1;
+        return -1;
+    }
+    p->outFd = fds[0];
+    return 0;
+}
+
+static void party_read(struct PartyRun *p) {
+    if (p->cap - p->len < 4096) {
+        size_t cap = p->cap ? p->cap * 2 : 16384;
+        char *grown = realloc(p->out, cap);
+        if (!grown) { // keep what we have and stop listening
+            close(p->outFd);
+            p->outFd = -1;
+            return;
+        }
+        p->out = grown;
+        p->cap = cap;
+    }
+    ssize_t n = read(p->outFd, p->out + p->len, p->cap - p->len - 1);
+    if (n > 0) {
+        p->len += (size_t)n;
+        p->out[p->len] = '\0';
+    } else if (n == 0 || errno != EINTR) {
+        close(p->outFd); // EOF: the driver and all its roles are gone
+        p->outFd = -1;
+    }
+}
+
+// Picks the summary lines of local_dungeon_report() out of everything the party printed
+static void party_parse(struct PartyRun *p) {
+    if (!p->out) return;
+    for (char *line = p->out; line && *line; ) {
+        char *nl = strchr(line, '\n');
+        if (nl) *nl = '\0';
+        double secs;
+        struct RoundResult r;
+        if (sscanf(line, "[Dungeon] %u rounds in %lf s (%lf rounds/s)", &p->rounds, &secs, &p->rate) == 3) {
+            p->reported = true;
+        } else if (p->ntypes < MAX_ROUND_TYPES &&
+                   sscanf(line, "  %15s %u/%u (%*f%%)  reaction p50=%lfus p99=%lfus", r.name, &r.wins,
+                          &r.attempts, &r.p50Us, &r.p99Us) == 5) {
+            p->types[p->ntypes++] = r;
+        }
+        if (nl) *nl = '\n';
+        line = nl ? nl + 1 : NULL;
+    }
+}
+
+static int run_sweep(int n, char **driverArgs, int nargs, bool pin, bool verbose, struct SweepResult *res) {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu < 1) ncpu = 1;
+    unsigned long saved[CPU_MASK_WORDS];
+    if (pin && !get_affinity(saved)) pin = false;
+
+    struct PartyRun *parties = calloc((size_t)n, sizeof(*parties));
+    if (!parties) return -1;
+    memset(res, 0, sizeof(*res));
+    res->parties = n;
+
+    uint64_t start = dungeon_now_ns();
+    int running = 0;
+    for (int i = 0; i < n; ++i) {
+        struct PartyRun *p = &parties[i];
+        p->outFd = -1;
+        snprintf(p->instance, sizeof(p->instance), "%d-%d", (int)getpid(), i);
+        party_cpus(i, n, (int)ncpu, &p->cpuFirst, &p->cpuCount);
+        if (!pin) p->cpuCount = 0;
+        if (party_spawn(p, i, driverArgs, nargs, pin, saved) == 0) ++running;
+    }
+
+    // collect every party's output until all of them have closed it
+    while (running > 0) {
+        struct pollfd pfds[MAX_PARTIES];
+        int who[MAX_PARTIES];
+        nfds_t k = 0;
+        for (int i = 0; i < n; ++i) {
+            if (parties[i].outFd >= 0) {
+                pfds[k].fd = parties[i].outFd;
+                pfds[k].events = POLLIN;
+                who[k++] = i;
+            }
+        }
+        if (k == 0) break;
+        if (poll(pfds, k, -1) == -1) {
+            if (errno == EINTR) continue;
+            perror("supervisor poll");
+            break;
+        }
+        for (nfds_t j = 0; j < k; ++j) {
+            if (pfds[j].revents) party_read(&parties[who[j]]);
+        }
+    }
+    for (int i = 0; i < n; ++i) {
+        if (parties[i].pid > 0) waitpid(parties[i].pid, &parties[i].status, 0);
+    }
+    res->secs = (double)(dungeon_now_ns() - start) / 1e9;
+
+    printf("[Supervisor] %d part%s on %ld cpus%s\n", n, n == 1 ? "y" : "ies", ncpu, pin ? "" : ", unpinned");
+    printf("  %-5s %-12s %-7s %8s %10s", "party", "instance", "cpus", "rounds", "rounds/s");
+    bool header = false;
+    for (int i = 0; i < n; ++i) {
+        struct PartyRun *p = &parties[i];
+        party_parse(p);
+        if (verbose && p->out) {
+            printf("\n----- party %d (%s)\n%s-----", i, p->instance, p->out);
+        }
+        if (!header && p->ntypes > 0) { // the round names come from the first full report
+            for (int t = 0; t < p->ntypes; ++t) {
+                printf(" %12s", p->types[t].name);
+                snprintf(res->typeNames[t], sizeof(res->typeNames[t]), "%s", p->types[t].name);
+            }
+            res->ntypes = p->ntypes;
+            header = true;
+        }
+    }
+    printf("%s\n", header ? "  (p99 reaction)" : "");
+
+    for (int i = 0; i < n; ++i) {
+        struct PartyRun *p = &parties[i];
+        char cpus[16] = "-";
+        if (p->cpuCount == 1) snprintf(cpus, sizeof(cpus), "%d", p->cpuFirst);
+        if (p->cpuCount > 1) snprintf(cpus, sizeof(cpus), "%d-%d", p->cpuFirst, p->cpuFirst + p->cpuCount - 1);
+        bool ok = p->reported && WIFEXITED(p->status) && WEXITSTATUS(p->status) == 0;
+        if (!ok) {
+            printf("  %-5d %-12s %-7s failed\n", i, p->instance, cpus);
+            res->failed++;
+            continue;
+        }
+        printf("  %-5d %-12s %-7s %8u %10.1f", i, p->instance, cpus, p->rounds, p->rate);
+        for (int t = 0; t < res->ntypes; ++t) {
+            for (int u = 0; u < p->ntypes; ++u) {
+                if (strcmp(p->types[u].name, res->typeNames[t]) != 0) continue;
+                printf(" %10.1fus", p->types[u].p99Us);
+                if (p->types[u].p99Us > res->worstP99Us[t]) res->worstP99Us[t] = p->types[u].p99Us;
+            }
+        }
+        printf("\n");
+        res->rounds += p->rounds;
+    }
+    // over the sweep's wall clock, not a sum of each party's own rate: parties that take turns
+    // on one CPU each report their own window, and adding those up counts the same time twice
+    res->rate = res->secs > 0 ? (double)res->rounds / res->secs : 0.0;
+    printf("[Supervisor] %d part%s: %u rounds in %.3f s, aggregate %.1f rounds/s (%.1f per party)%s\n",
+           n, n == 1 ? "y" : "ies", res->rounds, res->secs, res->rate,
+           n > res->failed ? res->rate / (double)(n - res->failed) : 0.0,
+           res->failed ? ", some parties failed" : "");
+    fflush(stdout);
+
+    for (int i = 0; i < n; ++i) {
+        if (parties[i].outFd >= 0) close(parties[i].outFd);
+        free(parties[i].out);
+    }
+    free(parties);
+    return res->failed ? -1 : 0;
+}
+
+int main(int argc, char **argv) {
+    int sweep[MAX_SWEEP] = { 1, 2, 4 };
+    int nsweep = 3;
+    bool pin = true;
+    bool verbose = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "N:uv")) != -1) {
+        switch (opt) {
+        case 'N': {
+            nsweep = 0;
+            for (char *tok = strtok(optarg, ","); tok && nsweep < MAX_SWEEP; tok = strtok(NULL, ",")) {
+                sweep[nsweep++] = atoi(tok);
+            }
+            break;
+        }
+        case 'u': pin = false; break;
+        case 'v': verbose = true; break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    for (int i = 0; i < nsweep; ++i) {
+        if (sweep[i] < 1 || sweep[i] > MAX_PARTIES) {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (nsweep == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    char **driverArgs = argv + optind; // everything after "--"
+    int nargs = argc - optind;
+    if (nargs == 0) {
+        driverArgs = default_driver_args;
+        nargs = (int)(sizeof(default_driver_args) / sizeof(default_driver_args[0])) - 1;
+    }
+
+    struct SweepResult results[MAX_SWEEP];
+    int rc = 0;
+    for (int i = 0; i < nsweep; ++i) {
+        if (run_sweep(sweep[i], driverArgs, nargs, pin, verbose, &results[i]) != 0) rc = 1;
+    }
+    if (nsweep < 2) return rc;
+
+    // how the aggregate throughput and the worst tails move with the number of parties
+    printf("[Supervisor] scaling\n  %7s %12s %12s %8s", "parties", "rounds/s", "per party", "speedup");
+    for (int t = 0; t < results[0].ntypes; ++t) {
+        printf(" %14s", results[0].typeNames[t]);
+    }
+    printf("%s\n", results[0].ntypes ? "  (worst p99)" : "");
+    double base = results[0].rate > 0 ? results[0].rate : 1.0;
+    for (int i = 0; i < nsweep; ++i) {
+        struct SweepResult *r = &results[i];
+        int ok = r->parties - r->failed;
+        printf("  %7d %12.1f %12.1f %7.2fx", r->parties, r->rate, ok > 0 ? r->rate / ok : 0.0, r->rate / base);
+        for (int t = 0; t < results[0].ntypes; ++t) {
+            int u = sweep_type(r, results[0].typeNames[t]);
+            if (u < 0) printf(" %14s", "-");
+            else printf(" %12.1fus", r->worstP99Us[u]);
+        }
+        printf("\n");
+    }
+    return rc;
+}
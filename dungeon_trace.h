@@ -0,0 +1,190 @@
+#ifndef DUNGEON_TRACE_H
+#define DUNGEON_TRACE_H
+//Event tracing into /DungeonTrace, a third shared-memory segment created by the launcher when
+//DUNGEON_TRACE names a file. The launcher and each role process own one ring of timestamped
+//events and are its only writer: an event is a cycle-counter read, three plain stores and a
+//release store of the head, with no lock and no shared cache line. The oldest events are
+//overwritten when a ring wraps. At the end the launcher saves the segment to the file, and
+//dungeontrace turns it into Chrome/Perfetto trace JSON.
+//With tracing off there is no segment, every ring pointer is NULL and trace_event() is one
+//predictable branch.
+//Files that include this need _DEFAULT_SOURCE (or _GNU_SOURCE).
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "dungeon_info.h"
+#include "dungeon_clock.h"
+#include "dungeon_names.h"
+
+#define DUNGEON_TRACE_ENV "DUNGEON_TRACE" //file the trace is saved to; unset: no tracing
+#define DUNGEON_TRACE_MAGIC (0x43525444u) //"DTRC"
+#define DUNGEON_TRACE_VERSION (1u)
+#define TRACE_RING_EVENTS (1u << 15) //per process, a power of two
+
+//Ring slots: the roles use their DungeonRole, the launcher the one after them.
+#define TRACE_SLOT_LAUNCHER (NUM_ROLES)
+#define NUM_TRACE_SLOTS (NUM_ROLES + 1)
+
+enum TraceEventType{
+	TRACE_SIGNAL = 1,        //arg: signal number, as read from the signalfd
+	TRACE_RING = 2,          //arg: DOORBELL_* bits taken
+	TRACE_HANDLER_BEGIN = 3, //arg: enum TraceHandler
+	TRACE_HANDLER_END = 4,   //arg: enum TraceHandler
+	TRACE_WRITE_ATTACK = 5,  //arg: barbarian.attack
+	TRACE_WRITE_PICK = 6,    //arg: rogue.pick, the bits of the float
+	TRACE_WRITE_SPELL = 7,   //arg: length of wizard.spell
+	TRACE_WRITE_SPOIL = 8,   //arg: slot << 8 | character
+	TRACE_SEM_WAIT = 9,      //arg: enum TraceSem; a wait starts
+	TRACE_SEM_ACQUIRED = 10, //arg: enum TraceSem; the wait returned (value 0: timed out)
+	TRACE_SEM_POST = 11,     //arg: enum TraceSem
+	TRACE_MARK = 12          //arg: enum TraceMark
+};
+
+enum TraceHandler{
+	TRACE_ATTACK = 0,
+	TRACE_LEVERS = 1,
+	TRACE_DECODE = 2,
+	TRACE_PICK = 3,
+	TRACE_TREASURE = 4,
+	NUM_TRACE_HANDLERS = 5
+};
+
+enum TraceSem{
+	TRACE_LEVER_ONE = 0,
+	TRACE_LEVER_TWO = 1,
+	TRACE_SPOILS_READY = 2,
+	NUM_TRACE_SEMS = 3
+};
+
+enum TraceMark{
+	TRACE_ROLES_SPAWNED = 0,
+	TRACE_ROLES_READY = 1,
+	TRACE_DUNGEON_START = 2,
+	TRACE_DUNGEON_END = 3,
+	TRACE_TEARDOWN = 4,
+	NUM_TRACE_MARKS = 5
+};
+
+static const char *const trace_handler_names[NUM_TRACE_HANDLERS] = {
+	"attack", "levers", "decode", "pick lock", "treasure"
+};
+static const char *const trace_sem_names[NUM_TRACE_SEMS] = { "LeverOne", "LeverTwo", "SpoilsReady" };
+static const char *const trace_mark_names[NUM_TRACE_MARKS] = {
+	"roles spawned", "roles ready", "dungeon start", "dungeon end", "teardown"
+};
+
+struct TraceEvent{
+	uint64_t ticks; //trace_ticks()
+	uint32_t type;
+	uint32_t arg;
+};
+
+struct TraceRing{
+	alignas(DUNGEON_CACHE_LINE) _Atomic uint64_t head; //events ever written; slot is head % size
+	_Atomic int32_t pid;
+	alignas(DUNGEON_CACHE_LINE) struct TraceEvent events[TRACE_RING_EVENTS];
+};
+
+struct DungeonTrace{
+	uint32_t magic;
+	uint32_t version;
+	//two (ticks, ns) pairs, at create and at save, to turn ticks into CLOCK_MONOTONIC time
+	uint64_t startTicks;
+	uint64_t startNs;
+	uint64_t endTicks;
+	uint64_t endNs;
+	struct TraceRing ring[NUM_TRACE_SLOTS];
+};
+
+//Cycle counter where there is a cheap one, else the monotonic clock (ticks are ns then).
+static inline uint64_t trace_ticks(void){
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+	uint64_t v;
+	__asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(v));
+	return v;
+#else
+	return dungeon_now_ns();
+#endif
+}
+
+static inline void trace_event(struct TraceRing *r, enum TraceEventType type, uint32_t arg){
+	if (!r) return;
+	uint64_t h = atomic_load_explicit(&r->head, memory_order_relaxed);
+	struct TraceEvent *e = &r->events[h & (TRACE_RING_EVENTS - 1)];
+	e->ticks = trace_ticks();
+	e->type = (uint32_t)type;
+	e->arg = arg;
+	atomic_store_explicit(&r->head, h + 1, memory_order_release); //event lands before the head moves
+}
+
+//Launcher: create the segment if DUNGEON_TRACE is set. NULL when tracing is off or failed.
+static inline struct DungeonTrace *dungeon_trace_create(void){
+	const char *path = getenv(DUNGEON_TRACE_ENV);
+	if (!path || !*path) return NULL;
+	int fd = shm_open(dungeon_names()->trace, O_CREAT | O_RDWR, 0666);
+	if (fd == -1) return NULL;
+	if (ftruncate(fd, sizeof(struct DungeonTrace)) == -1) {
+		close(fd);
+		return NULL;
+	}
+	struct DungeonTrace *t = mmap(NULL, sizeof(*t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (t == MAP_FAILED) return NULL;
+	memset(t, 0, sizeof(*t));
+	t->magic = DUNGEON_TRACE_MAGIC;
+	t->version = DUNGEON_TRACE_VERSION;
+	t->startTicks = trace_ticks();
+	t->startNs = dungeon_now_ns();
+	return t;
+}
+
+//Role: map the launcher's segment. NULL without one, which is the normal case.
+static inline struct DungeonTrace *dungeon_trace_open(void){
+	int fd = shm_open(dungeon_names()->trace, O_RDWR, 0);
+	if (fd == -1) return NULL;
+	struct DungeonTrace *t = mmap(NULL, sizeof(*t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (t == MAP_FAILED) return NULL;
+	if (t->magic != DUNGEON_TRACE_MAGIC || t->version != DUNGEON_TRACE_VERSION) {
+		munmap(t, sizeof(*t));
+		return NULL;
+	}
+	return t;
+}
+
+//The ring of one slot, stamped with this process's pid, or NULL without a segment.
+static inline struct TraceRing *dungeon_trace_ring(struct DungeonTrace *t, int slot){
+	if (!t) return NULL;
+	atomic_store_explicit(&t->ring[slot].pid, (int32_t)getpid(), memory_order_relaxed);
+	return &t->ring[slot];
+}
+
+static inline void dungeon_trace_close(struct DungeonTrace *t){
+	if (t) munmap(t, sizeof(*t));
+}
+
+//Launcher, after the roles are gone: save the segment to the DUNGEON_TRACE file, unmap, unlink.
+static inline void dungeon_trace_destroy(struct DungeonTrace *t){
+	if (!t) return;
+	t->endTicks = trace_ticks();
+	t->endNs = dungeon_now_ns();
+	const char *path = getenv(DUNGEON_TRACE_ENV);
+	FILE *f = path ? fopen(path, "wb") : NULL;
+	if (!f || fwrite(t, sizeof(*t), 1, f) != 1) {
+		perror(path ? path : DUNGEON_TRACE_ENV);
+	}
+	if (f) fclose(f);
+	munmap(t, sizeof(*t));
+	shm_unlink(dungeon_names()->trace);
+}
+#endif
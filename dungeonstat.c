@@ -0,0 +1,183 @@
+// dungeonstat.c
+// Live view of the stats in /DungeonMem (dungeon_stats.h), like vmstat: attaches read-only while game or
+// dungeon_driver runs and prints each role's rates and latency percentiles every interval.
+//   dungeonstat [-a] [-i instance] [interval [count]]
+// Percentiles are estimated from the log2 buckets, so they are good to within a factor of two.
+
+#define _DEFAULT_SOURCE // shm_open(), setenv()
+
+#include <stdio.h> // printf()
+#include <stdlib.h> // atof(), atoi()
+#include <string.h> // memcpy()
+#include <unistd.h> // getopt(), usleep()
+#include <sys/mman.h> // munmap()
+
+#include "dungeon_info.h" // NUM_ROLES
+#include "dungeon_clock.h" // dungeon_now_ns()
+#include "dungeon_stats.h" // struct DungeonStats
+#include "dungeon_names.h" // DUNGEON_INSTANCE_ENV
+
+static const char *const role_names[NUM_ROLES] = { "wizard", "rogue", "barbarian" };
+
+// Plain copy of one role's block, so deltas and percentiles work on stable numbers
+struct RoleSnapshot {
+    int pid;
+    uint64_t signals, rings, events;
+    uint64_t count[NUM_ROLE_METRICS];
+    uint64_t max[NUM_ROLE_METRICS];
+    uint64_t buckets[NUM_ROLE_METRICS][LATENCY_BUCKETS];
+};
+
+static void snapshot(const struct DungeonStats *s, struct RoleSnapshot out[NUM_ROLES]) {
+    for (int r = 0; r < NUM_ROLES; ++r) {
+        const struct RoleStats *rs = &s->role[r];
+        struct RoleSnapshot *o = &out[r];
+        o->pid = atomic_load_explicit(&rs->pid, memory_order_relaxed);
+        o->signals = atomic_load_explicit(&rs->signals, memory_order_relaxed);
+        o->rings = atomic_load_explicit(&rs->rings, memory_order_relaxed);
+        o->events = atomic_load_explicit(&rs->events, memory_order_relaxed);
+        for (int m = 0; m < NUM_ROLE_METRICS; ++m) {
+            const struct StatHistogram *h = &rs->metric[m];
+            o->count[m] = atomic_load_explicit(&h->count, memory_order_acquire); // before the buckets
+            o->max[m] = atomic_load_explicit(&h->max, memory_order_relaxed);
+            for (int b = 0; b < LATENCY_BUCKETS; ++b) {
+                o->buckets[m][b] = atomic_load_explicit(&h->buckets[b], memory_order_relaxed);
+            }
+        }
+    }
+}
+
+// pct-th percentile of a bucket histogram, interpolated inside the bucket it falls in
+static double bucket_percentile(const uint64_t *buckets, uint64_t n, double pct) {
+    if (n == 0) return 0.0;
+    double want = pct / 100.0 * (double)n;
+    uint64_t seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; ++b) {
+        if (buckets[b] == 0) continue;
+        if ((double)(seen + buckets[b]) >= want) {
+            double lo = b == 0 ? 0.0 : (double)(1ull << b);
+            double hi = (double)(1ull << (b + 1));
+            double frac = (want - (double)seen) / (double)buckets[b];
+            return lo + (hi - lo) * frac;
+        }
+        seen += buckets[b];
+    }
+    return (double)(1ull << (LATENCY_BUCKETS - 1));
+}
+
+// ns as "850ns", "12.3us", "4.8ms"; pick ticks are a plain count
+static void format_value(char *buf, size_t size, double v, int metric) {
+    if (metric == METRIC_PICK_TICKS) {
+        snprintf(buf, size, "%.0f", v);
+    } else if (v < 1e3) {
+        snprintf(buf, size, "%.0fns", v);
+    } else if (v < 1e6) {
+        snprintf(buf, size, "%.1fus", v / 1e3);
+    } else if (v < 1e9) {
+        snprintf(buf, size, "%.1fms", v / 1e6);
+    } else {
+        snprintf(buf, size, "%.2fs", v / 1e9);
+    }
+}
+
+// One block per interval: a line per role with its rates, then one per metric it has samples for
+static void print_block(const struct RoleSnapshot *now, const struct RoleSnapshot *prev, double secs,
+                        double uptime) {
+    printf("--- %.1f s since the dungeon started\n", uptime);
+    printf("%-9s %7s %8s %8s %8s %-11s %8s %8s %8s %8s\n", "role", "pid", "sig/s", "ring/s", "evt/s",
+           "metric", "n/s", "p50", "p99", "max");
+    for (int r = 0; r < NUM_ROLES; ++r) {
+        const struct RoleSnapshot *a = &now[r];
+        const struct RoleSnapshot *b = &prev[r];
+        char lead[128];
+        snprintf(lead, sizeof(lead), "%-9s %7d %8.1f %8.1f %8.1f", role_names[r], a->pid,
+                 (double)(a->signals - b->signals) / secs, (double)(a->rings - b->rings) / secs,
+                 (double)(a->events - b->events) / secs);
+        int lines = 0;
+        for (int m = 0; m < NUM_ROLE_METRICS; ++m) {
+            if (a->count[m] == 0) continue; // never recorded by this role
+            uint64_t delta[LATENCY_BUCKETS];
+            for (int k = 0; k < LATENCY_BUCKETS; ++k) {
+                delta[k] = a->buckets[m][k] - b->buckets[m][k];
+            }
+            uint64_t n = a->count[m] - b->count[m];
+            char p50[16] = "-";
+            char p99[16] = "-";
+            char max[16];
+            if (n > 0) {
+                double top = (double)a->max[m]; // a bucket estimate can overshoot the real max
+                double v50 = bucket_percentile(delta, n, 50.0);
+                double v99 = bucket_percentile(delta, n, 99.0);
+                format_value(p50, sizeof(p50), v50 < top ? v50 : top, m);
+                format_value(p99, sizeof(p99), v99 < top ? v99 : top, m);
+            }
+            format_value(max, sizeof(max), (double)a->max[m], m);
+            printf("%-44s %-11s %8.1f %8s %8s %8s\n", lines == 0 ? lead : "",
+                   dungeon_metric_names[m], (double)n / secs, p50, p99, max);
+            ++lines;
+        }
+        if (lines == 0) printf("%-44s %-11s\n", lead, "-");
+    }
+    fflush(stdout);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-a] [-i instance] [interval [count]]\n"
+            "  interval  seconds between reports (default 1)\n"
+            "  count     number of reports (default: until the dungeon finishes)\n"
+            "  -a        one report of the totals since the dungeon started, then exit\n"
+            "  -i        the dungeon started with DUNGEON_INSTANCE=instance\n",
+            prog);
+}
+
+int main(int argc, char **argv) {
+    bool totals = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "ai:")) != -1) {
+        switch (opt) {
+        case 'a': totals = true; break;
+        case 'i': setenv(DUNGEON_INSTANCE_ENV, optarg, 1); break; // read by dungeon_names()
+        default: usage(argv[0]); return 1;
+        }
+    }
+    double interval = optind < argc ? atof(argv[optind]) : 1.0;
+    int count = optind + 1 < argc ? atoi(argv[optind + 1]) : -1;
+    if (interval <= 0.0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    struct DungeonStats *s = dungeon_stats_open(false);
+    if (!s) {
+        fprintf(stderr, "dungeonstat: no stats in %s; is game or dungeon_driver running?\n", dungeon_names()->shm);
+        return 1;
+    }
+
+    static struct RoleSnapshot prev[NUM_ROLES];
+    static struct RoleSnapshot now[NUM_ROLES];
+    uint64_t prevNs = s->startNs; // the first report covers everything since the start
+    if (totals) {
+        snapshot(s, now);
+        uint64_t t = dungeon_now_ns();
+        print_block(now, prev, (double)(t - s->startNs) / 1e9, (double)(t - s->startNs) / 1e9);
+        munmap(s, sizeof(*s));
+        return 0;
+    }
+
+    for (int i = 0; count < 0 || i < count; ++i) {
+        if (i > 0) usleep((useconds_t)(interval * 1e6));
+        bool live = atomic_load_explicit(&s->live, memory_order_acquire) != 0;
+        snapshot(s, now);
+        uint64_t t = dungeon_now_ns();
+        print_block(now, prev, (double)(t - prevNs) / 1e9, (double)(t - s->startNs) / 1e9);
+        memcpy(prev, now, sizeof(prev));
+        prevNs = t;
+        if (!live) {
+            printf("dungeonstat: dungeon finished\n");
+            break;
+        }
+    }
+    munmap(s, sizeof(*s));
+    return 0;
+}
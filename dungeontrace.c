@@ -0,0 +1,193 @@
+// dungeontrace.c
+// Turns a trace saved by game or dungeon_driver (DUNGEON_TRACE=file, see dungeon_trace.h) into
+// Chrome trace JSON, which chrome://tracing and ui.perfetto.dev open as one timeline per process:
+// handlers and semaphore waits as slices, signals, doorbell rings, field writes and posts as
+// instants, and the launcher's milestones across the whole trace.
+//   dungeontrace file > trace.json
+// A ring keeps its last TRACE_RING_EVENTS events, so a long run starts part way through; a slice
+// whose begin was overwritten is dropped.
+
+#define _DEFAULT_SOURCE // shm_open() in dungeon_trace.h
+
+#include <stdio.h> // printf()
+#include <stdlib.h> // qsort()
+#include <string.h> // memcpy()
+#include <fcntl.h> // open()
+#include <unistd.h> // close()
+#include <sys/mman.h> // mmap()
+#include <sys/stat.h> // fstat()
+
+#include "dungeon_info.h" // NUM_ROLES
+#include "dungeon_trace.h" // the saved segment
+
+static const char *const slot_names[NUM_TRACE_SLOTS] = { "wizard", "rogue", "barbarian", "launcher" };
+
+// One event with the slot it came from, so the rings can be merged by time
+struct Merged {
+    uint64_t ticks;
+    uint32_t type;
+    uint32_t arg;
+    int slot;
+};
+
+static int by_ticks(const void *a, const void *b) {
+    const struct Merged *x = a;
+    const struct Merged *y = b;
+    if (x->ticks != y->ticks) return x->ticks < y->ticks ? -1 : 1;
+    return x->slot - y->slot;
+}
+
+// Microseconds since the trace started, from the two calibration pairs
+static double to_us(const struct DungeonTrace *t, uint64_t ticks) {
+    double nsPerTick = 1.0;
+    if (t->endTicks > t->startTicks && t->endNs > t->startNs) {
+        nsPerTick = (double)(t->endNs - t->startNs) / (double)(t->endTicks - t->startTicks);
+    }
+    return (double)(int64_t)(ticks - t->startTicks) * nsPerTick / 1000.0;
+}
+
+static const char *name_of(const char *const *names, size_t count, uint32_t i) {
+    return i < count ? names[i] : "?";
+}
+
+static void event_head(int *first, const char *ph, int pid, double us) {
+    printf("%s\n  {\"ph\": \"%s\", \"pid\": %d, \"tid\": %d, \"ts\": %.3f", *first ? "" : ",", ph, pid, pid, us);
+    *first = 0;
+}
+
+static void print_event(const struct DungeonTrace *t, const struct Merged *e, int pid, int *depth, int *first) {
+    double us = to_us(t, e->ticks);
+    switch ((enum TraceEventType)e->type) {
+    case TRACE_HANDLER_BEGIN:
+        ++*depth;
+        event_head(first, "B", pid, us);
+        printf(", \"cat\": \"handler\", \"name\": \"%s\"}",
+               name_of(trace_handler_names, NUM_TRACE_HANDLERS, e->arg));
+        break;
+    case TRACE_SEM_WAIT:
+        ++*depth;
+        event_head(first, "B", pid, us);
+        printf(", \"cat\": \"sem\", \"name\": \"wait %s\"}", name_of(trace_sem_names, NUM_TRACE_SEMS, e->arg));
+        break;
+    case TRACE_HANDLER_END:
+    case TRACE_SEM_ACQUIRED:
+        if (*depth == 0) break; // its begin was overwritten
+        --*depth;
+        event_head(first, "E", pid, us);
+        printf("}");
+        break;
+    case TRACE_SIGNAL:
+        event_head(first, "i", pid, us);
+        printf(", \"s\": \"t\", \"cat\": \"notify\", \"name\": \"signal\", \"args\": {\"signo\": %u}}", e->arg);
+        break;
+    case TRACE_RING:
+        event_head(first, "i", pid, us);
+        printf(", \"s\": \"t\", \"cat\": \"notify\", \"name\": \"ring\", \"args\": {\"bits\": %u}}", e->arg);
+        break;
+    case TRACE_WRITE_ATTACK:
+        event_head(first, "i", pid, us);
+        printf(", \"s\": \"t\", \"cat\": \"write\", \"name\": \"attack\", \"args\": {\"value\": %d}}", (int32_t)e->arg);
+        break;
+    case TRACE_WRITE_PICK: {
+        float pick;
+        memcpy(&pick, &e->arg, sizeof(pick));
+        event_head(first, "i", pid, us);
+        printf(", \"s\": \"t\", \"cat\": \"write\", \"name\": \"pick\", \"args\": {\"value\": %.4f}}", (double)pick);
+        break;
+    }
+    case TRACE_WRITE_SPELL:
+        event_head(first, "i", pid, us);
+        printf(", \"s\": \"t\", \"cat\": \"write\", \"name\": \"spell\", \"args\": {\"length\": %u}}", e->arg);
+        break;
+    case TRACE_WRITE_SPOIL: {
+        unsigned char c = (unsigned char)(e->arg & 0xff);
+        event_head(first, "i", pid, us);
+        printf(", \"s\": \"t\", \"cat\": \"write\", \"name\": \"spoil\", \"args\": {\"slot\": %u, \"char\": %u}}",
+               e->arg >> 8, c);
+        break;
+    }
+    case TRACE_SEM_POST:
+        event_head(first, "i", pid, us);
+        printf(", \"s\": \"t\", \"cat\": \"sem\", \"name\": \"post %s\"}", name_of(trace_sem_names, NUM_TRACE_SEMS, e->arg));
+        break;
+    case TRACE_MARK:
+        event_head(first, "i", pid, us);
+        printf(", \"s\": \"g\", \"cat\": \"mark\", \"name\": \"%s\"}", name_of(trace_mark_names, NUM_TRACE_MARKS, e->arg));
+        break;
+    default:
+        break; // newer event types are skipped rather than guessed at
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s file > trace.json\n  file: what DUNGEON_TRACE named for the run\n", argv[0]);
+        return 1;
+    }
+    int fd = open(argv[1], O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1) {
+        perror(argv[1]);
+        return 1;
+    }
+    if ((size_t)st.st_size < sizeof(struct DungeonTrace)) {
+        fprintf(stderr, "dungeontrace: %s is not a dungeon trace\n", argv[1]);
+        return 1;
+    }
+    const struct DungeonTrace *t = mmap(NULL, sizeof(*t), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (t == MAP_FAILED || t->magic != DUNGEON_TRACE_MAGIC || t->version != DUNGEON_TRACE_VERSION) {
+        fprintf(stderr, "dungeontrace: %s is not a dungeon trace\n", argv[1]);
+        return 1;
+    }
+
+    // the events each ring still holds, oldest first
+    size_t total = 0;
+    uint64_t first[NUM_TRACE_SLOTS];
+    uint64_t head[NUM_TRACE_SLOTS];
+    for (int s = 0; s < NUM_TRACE_SLOTS; ++s) {
+        head[s] = atomic_load_explicit(&t->ring[s].head, memory_order_acquire);
+        first[s] = head[s] > TRACE_RING_EVENTS ? head[s] - TRACE_RING_EVENTS : 0;
+        total += (size_t)(head[s] - first[s]);
+    }
+    struct Merged *all = malloc((total ? total : 1) * sizeof(*all));
+    if (!all) {
+        perror("dungeontrace");
+        return 1;
+    }
+    size_t n = 0;
+    for (int s = 0; s < NUM_TRACE_SLOTS; ++s) {
+        for (uint64_t i = first[s]; i < head[s]; ++i) {
+            const struct TraceEvent *e = &t->ring[s].events[i & (TRACE_RING_EVENTS - 1)];
+            all[n++] = (struct Merged){ e->ticks, e->type, e->arg, s };
+        }
+    }
+    qsort(all, n, sizeof(*all), by_ticks);
+
+    int pids[NUM_TRACE_SLOTS];
+    int depth[NUM_TRACE_SLOTS] = { 0 };
+    int firstOut = 1;
+    printf("{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+    for (int s = 0; s < NUM_TRACE_SLOTS; ++s) {
+        pids[s] = atomic_load_explicit(&t->ring[s].pid, memory_order_relaxed);
+        if (pids[s] == 0) pids[s] = s + 1; // a role that never mapped its ring still gets a row
+        printf("%s\n  {\"ph\": \"M\", \"pid\": %d, \"name\": \"process_name\", \"args\": {\"name\": \"%s\"}},",
+               firstOut ? "" : ",", pids[s], slot_names[s]);
+        printf("\n  {\"ph\": \"M\", \"pid\": %d, \"name\": \"process_sort_index\", \"args\": {\"sort_index\": %d}}",
+               pids[s], s);
+        firstOut = 0;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        print_event(t, &all[i], pids[all[i].slot], &depth[all[i].slot], &firstOut);
+    }
+    printf("\n]}\n");
+
+    size_t dropped = 0;
+    for (int s = 0; s < NUM_TRACE_SLOTS; ++s) dropped += (size_t)first[s];
+    fprintf(stderr, "[Trace] %zu events over %.1f ms from %s", n, (double)(t->endNs - t->startNs) / 1e6, argv[1]);
+    if (dropped) fprintf(stderr, " (%zu older events overwritten)", dropped);
+    fprintf(stderr, "\n");
+    free(all);
+    munmap((void *)t, sizeof(*t));
+    return 0;
+}
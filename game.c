@@ -2,7 +2,7 @@
 // Main launcher for thsi lab 
 // Starts shared memory, spawns Barbarian/Wizard/Rogue, then runs the dungeon.
 
-#define _POSIX_C_SOURCE 200809L // extension for POSIX 
+#define _DEFAULT_SOURCE // POSIX plus syscall() for the doorbell futex 
 
 #include <stdio.h> // printf()
 #include <stdlib.h>//exit()
@@ -16,93 +16,76 @@
 
 #include "dungeon_info.h" // sared memory struct and semaphore 
 #include "dungeon_settings.h" // gameplay constants 
+#include "dungeon_doorbell.h" // role wakeups 
+#include "dungeon_launch.h" // create_shared_dungeon(), start_process(), stop_roles() 
+#include "dungeon_supervise.h" // respawn crashed roles while the dungeon runs 
+#include "dungeon_atomic.h" // dungeon_set_running() 
 
-// Helper to create shared memory for Dungeon struct
-struct Dungeon* create_shared_dungeon() {
-    int fd = shm_open(dungeon_shm_name, O_CREAT | O_RDWR, 0666);//create if missing open read and write , permission for everyone 
-    if (fd == -1) {
-        perror("shm_open");
-        exit(1);
-    }
+#define ROLE_READY_TIMEOUT_MS (5000) // as long as the roles' old shm_open() retry loop 
+#define ROLE_EXIT_TIMEOUT_MS (3000) // roles exit within milliseconds of the shutdown ring; a stuck one is killed after this 
 
-    if (ftruncate(fd, sizeof(struct Dungeon)) == -1) { // resize shared memory to fit our dungeon struct 
-        perror("ftruncate");
-        exit(1);
-    }
-// map shared memory into the game process 
-    struct Dungeon *d =
-        mmap(NULL, sizeof(struct Dungeon),
-             PROT_READ | PROT_WRITE, // read and write access 
-             MAP_SHARED, // visible to child process 
-             fd,
-             0);
-
-    close(fd); // fd no longer needed after mmap()
-
-    if (d == MAP_FAILED) {
-        perror("mmap");
-        exit(1);
-    }
-//initizalze the dungeon stuct to zeros 
-    memset(d, 0, sizeof(struct Dungeon));
-    d->running = true; // set running flag so other known dungeon is active 
+#ifdef DUNGEON_PARTITIONED_LAYOUT
+#error "RunDungeon() from the prebuilt dungeon object only understands the packed struct Dungeon layout"
+#endif
 
-    return d;
-}
+int main(void) {
+    dungeon_rt_apply("Game", DUNGEON_RT_GAME); // opt-in real-time profile, see dungeon_rt.h 
 
-// Helper to start one process
-pid_t start_process(const char *name, const char *path) {
-    pid_t pid = fork();
-    if (pid < 0) {
-        perror("fork");
-        exit(1);
+    // RunDungeon() opens /DungeonMem and the levers by their plain names, so no instance suffix 
+    if (getenv(DUNGEON_INSTANCE_ENV)) {
+        fprintf(stderr, "Game: ignoring %s, the prebuilt dungeon only knows the default names\n",
+                DUNGEON_INSTANCE_ENV);
+        unsetenv(DUNGEON_INSTANCE_ENV);
     }
-    if (pid == 0) {// cild process 
-        execl(path, name, NULL);
-        perror("execl failed"); // if exelcl returns, something failed 
-        exit(1);
-    } // parent process 
-    return pid;
-}
 
-int main(void) {
+    uint64_t launchNs = dungeon_now_ns(); // time to ready is measured from here 
 
     // Shared memory
-    struct Dungeon *d = create_shared_dungeon();
+    struct Dungeon *d = create_shared_dungeon(0);
 
     // Create semaphores for treasure room
-    sem_t *lever1 = sem_open(dungeon_lever_one, O_CREAT, 0666, 1);
-    sem_t *lever2 = sem_open(dungeon_lever_two, O_CREAT, 0666, 1);
-
-    if (lever1 == SEM_FAILED || lever2 == SEM_FAILED) {
-        perror("sem_open");
-        exit(1);
-    }
+    sem_t *lever1;
+    sem_t *lever2;
+    open_levers(&lever1, &lever2);
 
     // Start each character
     pid_t barbarian_pid = start_process("barbarian", "./barbarian");
     pid_t wizard_pid    = start_process("wizard",    "./wizard");
     pid_t rogue_pid     = start_process("rogue",     "./rogue");
+    trace_event(g_trace, TRACE_MARK, TRACE_ROLES_SPAWNED);
    // print PIDs for debugging 
     printf("Game: spawned processes\n");
     printf("  Barbarian: %d\n", barbarian_pid);
     printf("  Wizard:    %d\n", wizard_pid);
     printf("  Rogue:     %d\n", rogue_pid);
 
+    // RunDungeon() signals right away, so only start once every role can take a signal 
+    if (dungeon_wait_ready(d, NUM_ROLES, ROLE_READY_TIMEOUT_MS) < NUM_ROLES) {
+        fprintf(stderr, "Game: not every role became ready, starting anyway\n");
+    }
+    report_ready("Game", d, launchNs);
+
+    // a role that crashes from here on is replaced; RunDungeon() still signals the old pid, so
+    // the supervisor forwards the rounds to the replacement's doorbell 
+    pid_t pids[NUM_ROLES];
+    pids[ROLE_WIZARD] = wizard_pid;
+    pids[ROLE_ROGUE] = rogue_pid;
+    pids[ROLE_BARBARIAN] = barbarian_pid;
+    struct RoleSupervisor sup;
+    supervisor_start(&sup, "Game", d, pids, true);
+
     //  Run the dungeon
     // ORDER = RunDungeon(wizard, rogue, barbarian)
+    trace_event(g_trace, TRACE_MARK, TRACE_DUNGEON_START);
     RunDungeon(wizard_pid, rogue_pid, barbarian_pid);
+    trace_event(g_trace, TRACE_MARK, TRACE_DUNGEON_END);
 
-    //  Dungeon is finished → tell processes to shut down
-    d->running = false;
+    //  Dungeon is finished → tell processes to shut down and wait for them to exit 
+    supervisor_finish(&sup, ROLE_EXIT_TIMEOUT_MS);
 
-    kill(barbarian_pid, SIGTERM);
-    kill(wizard_pid, SIGTERM);
-    kill(rogue_pid, SIGTERM);
-// give processes time to exit cleanly 	
-    sleep(1);
-    munmap(d, sizeof(struct Dungeon)); // cleanup shared memory and semaphores 
-    shm_unlink(dungeon_shm_name);
+    // cleanup semaphores and shared memory 
+    close_levers(lever1, lever2);
+    destroy_shared_dungeon(d);
 
     printf("Game finished. Clean exit.\n");
     return 0;
@@ -0,0 +1,617 @@
+// local_dungeon.c
+// Round engine for the in-tree dungeon driver. Speaks the same protocol as RunDungeon():
+// fields in struct Dungeon, DUNGEON_SIGNAL/SEMAPHORE_SIGNAL (or the doorbell), and the
+// /LeverOne and /LeverTwo semaphores in the treasure room.
+#define _GNU_SOURCE // syscall(), usleep(), sem_clockwait()
+
+#include <errno.h> // EINTR
+#include <math.h> // fabsf()
+#include <signal.h> // kill()
+#include <stdlib.h> // rand_r()
+#include <string.h> // memset(), strcmp()
+#include <time.h> // nanosleep()
+#include <unistd.h> // usleep()
+
+#include "local_dungeon.h"
+#include "dungeon_settings.h" // LOCK_THRESHOLD, MAX_PICK_ANGLE, ALLOW_*
+#include "dungeon_doorbell.h" // doorbell_ring()
+#include "dungeon_atomic.h" // field accessors, seqlock writers
+#include "dungeon_queue.h" // queued monster and barrier rounds
+#include "dungeon_log.h" // the round log
+#include "spell_phrases.h" // the barrier phrases
+
+static const char letters[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+const char *local_dungeon_round_name(enum RoundType type) {
+    switch (type) {
+    case ROUND_MONSTER:  return "monster";
+    case ROUND_BARRIER:  return "barrier";
+    case ROUND_TRAP:     return "trap";
+    case ROUND_TREASURE: return "treasure";
+    default:             return "?";
+    }
+}
+
+void local_dungeon_defaults(struct LocalDungeonConfig *cfg, bool turbo) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->rounds = NUM_ROUNDS;
+    cfg->treasureRounds = 1;
+    cfg->seed = (unsigned)time(NULL) ^ (unsigned)getpid();
+    if (turbo) {
+        cfg->attackUs   = 5000;
+        cfg->barrierUs  = 5000;
+        cfg->pickUs     = 100000;
+        cfg->tickUs     = 500;
+        cfg->treasureUs = 100000;
+        cfg->pollUs     = 5;
+    } else {
+        cfg->attackUs   = SECONDS_TO_ATTACK * 1000000L;
+        cfg->barrierUs  = SECONDS_TO_GUESS_BARRIER * 1000000L;
+        cfg->pickUs     = SECONDS_TO_PICK * 1000000L;
+        cfg->tickUs     = TIME_BETWEEN_ROGUE_TICKS;
+        cfg->treasureUs = TIME_TREASURE_AVAILABLE * 1000000L;
+        cfg->pollUs     = 100;
+    }
+}
+
+void local_dungeon_init(struct LocalDungeon *ld, struct Dungeon *d, const pid_t pids[NUM_ROLES],
+                        sem_t *lever1, sem_t *lever2, const struct LocalDungeonConfig *cfg) {
+    memset(ld, 0, sizeof(*ld));
+    ld->dungeon = d;
+    for (int r = 0; r < NUM_ROLES; ++r) {
+        ld->pids[r] = pids ? pids[r] : 0;
+    }
+    ld->lever1 = lever1;
+    ld->lever2 = lever2;
+    ld->cfg = *cfg;
+    ld->rng = cfg->seed;
+}
+
+size_t local_dungeon_arena_capacity(const struct LocalDungeonConfig *cfg) {
+    size_t bytes = (cfg->spellBytes ? cfg->spellBytes : SPELL_BUFFER_SIZE) + 1; // with the key byte
+    // queue mode: up to QUEUE_DEPTH records still out with the wizard (a timed-out burst it may be
+    // decoding), and room for the next QUEUE_DEPTH next to them
+    if (cfg->queueBatch > 0) return 2 * QUEUE_DEPTH * spell_record_size(bytes);
+    return cfg->spellBytes ? spell_arena_capacity(bytes) : 0;
+}
+
+void local_dungeon_free(struct LocalDungeon *ld) {
+    free(ld->plain);
+    ld->plain = NULL;
+    free(ld->commands.samples);
+    ld->commands.samples = NULL;
+    for (int t = 0; t < NUM_ROUND_TYPES; ++t) {
+        free(ld->stats[t].samples);
+        ld->stats[t].samples = NULL;
+        ld->stats[t].sampleCount = ld->stats[t].sampleCap = 0;
+    }
+}
+
+// wake a role the way the configuration asks for
+static void notify(struct LocalDungeon *ld, enum DungeonRole role, uint32_t bits) {
+    pid_t pid = ld->pids[role];
+    if (ld->cfg.useSignals && pid > 0) {
+        kill(pid, (bits & DOORBELL_SEMAPHORE) ? SEMAPHORE_SIGNAL : DUNGEON_SIGNAL);
+    } else {
+        doorbell_ring(ld->dungeon, role, bits);
+    }
+}
+
+static void pause_us(long us) {
+    struct timespec ts = { .tv_sec = us / 1000000L, .tv_nsec = (us % 1000000L) * 1000L };
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+    }
+}
+
+static void stats_add(struct RoundStats *s, bool ok, uint64_t reactionNs) {
+    s->attempts++;
+    if (!ok) return;
+    s->successes++;
+    latency_record(&s->reaction, reactionNs);
+    if (s->sampleCount == s->sampleCap) {
+        size_t cap = s->sampleCap ? s->sampleCap * 2 : 256;
+        uint64_t *grown = realloc(s->samples, cap * sizeof(*grown));
+        if (!grown) return; // keep the mean/max, lose the percentile sample
+        s->samples = grown;
+        s->sampleCap = cap;
+    }
+    s->samples[s->sampleCount++] = reactionNs;
+}
+
+static void record(struct LocalDungeon *ld, enum RoundType type, bool ok, uint64_t reactionNs) {
+    stats_add(&ld->stats[type], ok, reactionNs);
+}
+
+// Log a round's input as the dungeon publishes it at t. Returns the round's number in the log,
+// for log_judged().
+static uint32_t log_published(struct LocalDungeon *ld, uint64_t t, enum DungeonLogKind kind, int32_t value,
+                              const void *text, uint16_t len) {
+    if (ld->log) dungeon_log_append(ld->log, t, kind, 0, value, text, len);
+    ld->roundNs = t;
+    return ld->loggedRounds++;
+}
+
+static void log_judged(struct LocalDungeon *ld, uint32_t round, bool ok, uint64_t t) {
+    if (ld->log) dungeon_log_append(ld->log, t, LOG_JUDGED, ok ? 1 : 0, (int32_t)round, NULL, 0);
+}
+
+static uint16_t spell_log_len(const char *spell) {
+    return (uint16_t)(strnlen(spell, SPELL_BUFFER_SIZE) + 1);
+}
+
+// Monster: publish a health value, the barbarian must copy it into attack.
+static bool round_monster(struct LocalDungeon *ld, int health, uint64_t *reaction) {
+    struct Dungeon *d = ld->dungeon;
+    if (health == dungeon_load_attack(d)) health++; // a stale attack must not count
+
+    uint64_t start = dungeon_now_ns();
+    dungeon_publish_health(d, health, start);
+    ld->roundNo = log_published(ld, start, LOG_HEALTH, health, NULL, 0);
+    notify(ld, ROLE_BARBARIAN, DOORBELL_ENCOUNTER);
+
+    uint64_t deadline = start + (uint64_t)ld->cfg.attackUs * 1000ull;
+    while (dungeon_now_ns() < deadline) {
+        if (dungeon_load_attack(d) == health) {
+            *reaction = dungeon_now_ns() - start;
+            return true;
+        }
+        pause_us(ld->cfg.pollUs);
+    }
+    return false;
+}
+
+static char caesar_encode(char c, int shift) {
+    if (c >= 'A' && c <= 'Z') return (char)('A' + (c - 'A' + shift) % 26);
+    if (c >= 'a' && c <= 'z') return (char)('a' + (c - 'a' + shift) % 26);
+    return c;
+}
+
+// Large-spell plaintext: the phrase over and over, space separated, cfg.spellBytes in all
+static bool large_plain(struct LocalDungeon *ld, const char *phrase) {
+    size_t n = ld->cfg.spellBytes;
+    if (!ld->plain && !(ld->plain = malloc(n))) return false;
+    size_t len = strlen(phrase);
+    for (size_t i = 0; i < n; i += len + 1) {
+        size_t take = n - i < len ? n - i : len;
+        memcpy(ld->plain + i, phrase, take);
+        if (i + take < n) ld->plain[i + take] = ' ';
+    }
+    return true;
+}
+
+// Write a barrier's spell into a new arena record: the round's own (key + encoded phrase), or in
+// large-spell mode its phrase repeated to cfg.spellBytes under the same key. *length counts the
+// key byte.
+static bool arena_write_spell(struct LocalDungeon *ld, const struct RoundInput *in, uint64_t *offset,
+                              size_t *length) {
+    if (!ld->cfg.spellBytes) {
+        *length = strnlen(in->spell, sizeof(in->spell));
+        char *spell = spell_arena_reserve(ld->spells, *length, offset);
+        if (spell) memcpy(spell, in->spell, *length);
+        return spell != NULL;
+    }
+    if (!large_plain(ld, in->answer)) return false;
+    size_t n = ld->cfg.spellBytes;
+    *length = n + 1;
+    char *spell = spell_arena_reserve(ld->spells, n + 1, offset);
+    if (!spell) return false;
+    int shift = ((unsigned char)in->spell[0]) % 26;
+    spell[0] = in->spell[0];
+    for (size_t i = 0; i < n; ++i) {
+        spell[i + 1] = caesar_encode(ld->plain[i], shift);
+    }
+    return true;
+}
+
+// Does a plaintext the wizard published answer the round? Large ones leave ld->plain as expected.
+static bool spell_matches(struct LocalDungeon *ld, const struct RoundInput *in, const char *answer, size_t n) {
+    if (!ld->cfg.spellBytes) return n == strlen(in->answer) && memcmp(answer, in->answer, n) == 0;
+    return n == ld->cfg.spellBytes && large_plain(ld, in->answer) && memcmp(answer, ld->plain, n) == 0;
+}
+
+// Large-spell barrier: the phrase repeated to cfg.spellBytes, encoded with the same key into a
+// spell arena record. The wizard must publish a plaintext that matches byte for byte.
+static bool round_large_barrier(struct LocalDungeon *ld, const struct RoundInput *in, uint64_t *reaction) {
+    struct SpellArena *a = ld->spells;
+    uint64_t offset;
+    size_t length;
+    if (!arena_write_spell(ld, in, &offset, &length)) return false;
+    uint64_t seq = spell_arena_publish(a, offset);
+    uint64_t start = dungeon_now_ns();
+    ld->roundNo = log_published(ld, start, LOG_SPELL, 0, in->spell, spell_log_len(in->spell)); // its short form
+    notify(ld, ROLE_WIZARD, DOORBELL_ENCOUNTER);
+
+    uint64_t deadline = start + (uint64_t)ld->cfg.barrierUs * 1000ull;
+    while (dungeon_now_ns() < deadline) {
+        size_t got;
+        const char *answer = spell_arena_answered(a, seq, &got);
+        if (answer) {
+            *reaction = dungeon_now_ns() - start;
+            return spell_matches(ld, in, answer, got); // checked after the clock stops
+        }
+        pause_us(ld->cfg.pollUs);
+    }
+    return false;
+}
+
+// Barrier: publish a Caesar-encoded phrase (key character first), the wizard must write the
+// plaintext.
+static bool round_barrier(struct LocalDungeon *ld, const struct RoundInput *in, uint64_t *reaction) {
+    struct Dungeon *d = ld->dungeon;
+    if (ld->spells && ld->cfg.spellBytes) {
+        return round_large_barrier(ld, in, reaction);
+    }
+    const char *encoded = in->spell;
+    const char *phrase = in->answer;
+    size_t n = strnlen(encoded, SPELL_BUFFER_SIZE);
+
+    memset(d->wizard.spell, 0, sizeof(d->wizard.spell));
+    dungeon_write_barrier(d, encoded, n + 1);
+    uint64_t start = dungeon_now_ns();
+    ld->roundNo = log_published(ld, start, LOG_SPELL, 0, encoded, spell_log_len(encoded));
+    notify(ld, ROLE_WIZARD, DOORBELL_ENCOUNTER);
+
+    uint64_t deadline = start + (uint64_t)ld->cfg.barrierUs * 1000ull;
+    while (dungeon_now_ns() < deadline) {
+        if (strcmp((const char *)(volatile char *)d->wizard.spell, phrase) == 0) {
+            *reaction = dungeon_now_ns() - start;
+            return true;
+        }
+        pause_us(ld->cfg.pollUs);
+    }
+    return false;
+}
+
+// Trap: every tick, judge the rogue's pick with 'u'/'d' until it is within LOCK_THRESHOLD.
+static bool round_trap(struct LocalDungeon *ld, float target, uint64_t *reaction) {
+    struct Dungeon *d = ld->dungeon;
+
+    dungeon_store_direction(d, 'w');
+    dungeon_set_trap_locked(d, true);
+    uint64_t start = dungeon_now_ns();
+    ld->roundNo = log_published(ld, start, LOG_TRAP, 'w' | 1 << 8, NULL, 0);
+    if (ld->log) {
+        int32_t bits;
+        memcpy(&bits, &target, sizeof(bits));
+        dungeon_log_append(ld->log, start, LOG_TARGET, 0, bits, NULL, 0);
+    }
+    notify(ld, ROLE_ROGUE, DOORBELL_ENCOUNTER);
+
+    uint64_t deadline = start + (uint64_t)ld->cfg.pickUs * 1000ull;
+    bool ok = false;
+    while (dungeon_now_ns() < deadline) {
+        float pick = dungeon_load_pick(d);
+        if (fabsf(pick - target) <= (float)LOCK_THRESHOLD) {
+            dungeon_store_direction(d, '-');
+            dungeon_set_trap_locked(d, false);
+            *reaction = dungeon_now_ns() - start;
+            ok = true;
+            break;
+        }
+        dungeon_store_direction(d, target > pick ? 'u' : 'd');
+        pause_us(ld->cfg.tickUs);
+    }
+    if (!ok) {
+        dungeon_store_direction(d, '-'); // time is up, release the rogue like RunDungeon() does
+        dungeon_set_trap_locked(d, false);
+    }
+    return ok;
+}
+
+static bool lever_held(sem_t *lever) {
+    int value = 1;
+    return sem_getvalue(lever, &value) == 0 && value <= 0;
+}
+
+static bool lever_wait(sem_t *lever, uint64_t deadlineNs) {
+    // deadlineNs is a dungeon_now_ns() time, so wait on that clock
+    struct timespec ts = { (time_t)(deadlineNs / 1000000000ull), (long)(deadlineNs % 1000000000ull) };
+    while (sem_clockwait(lever, CLOCK_MONOTONIC, &ts) == -1) {
+        if (errno != EINTR) return false;
+    }
+    return true;
+}
+
+// Treasure: the barbarian holds both levers, the treasure appears one character at a time,
+// the rogue copies it into spoils, and the barbarian lets go of the levers before time is up.
+static bool round_treasure(struct LocalDungeon *ld, const char treasure[4], uint64_t *reaction) {
+    struct Dungeon *d = ld->dungeon;
+    if (!ld->lever1 || !ld->lever2) return false;
+
+    for (int i = 0; i < 4; ++i) {
+        dungeon_write_treasure(d, i, '\0');
+        dungeon_store_spoil(d, i, '\0');
+    }
+
+    uint64_t start = dungeon_now_ns();
+    uint64_t deadline = start + (uint64_t)ld->cfg.treasureUs * 1000ull;
+    ld->roundNo = log_published(ld, start, LOG_TREASURE, 0, treasure, 4);
+    notify(ld, ROLE_BARBARIAN, DOORBELL_SEMAPHORE);
+    notify(ld, ROLE_ROGUE, DOORBELL_SEMAPHORE);
+
+    // door opens once both levers are down (give up waiting after a quarter of the window)
+    uint64_t grab_deadline = start + (uint64_t)ld->cfg.treasureUs * 250ull;
+    while (dungeon_now_ns() < grab_deadline && !(lever_held(ld->lever1) && lever_held(ld->lever2))) {
+        pause_us(ld->cfg.pollUs);
+    }
+    // like RunDungeon(), a round whose levers were never pulled fails however the treasure goes
+    bool held1 = lever_held(ld->lever1);
+    bool held2 = lever_held(ld->lever2);
+    if (ld->cfg.verbose) {
+        if (!held1) printf("[Dungeon] First lever semaphore was not downed.\n");
+        if (!held2) printf("[Dungeon] Second lever semaphore was not downed.\n");
+    }
+
+    // treasure shows up one character at a time, like in the prebuilt dungeon
+    long step_us = ld->cfg.treasureUs / 32;
+    for (int i = 0; i < 4; ++i) {
+        dungeon_write_treasure(d, i, treasure[i]);
+        pause_us(step_us);
+    }
+
+    bool copied = false;
+    while (dungeon_now_ns() < deadline) {
+        if (memcmp((const void *)(volatile char *)d->spoils, treasure, 4) == 0) {
+            *reaction = dungeon_now_ns() - start;
+            copied = true;
+            break;
+        }
+        pause_us(ld->cfg.pollUs);
+    }
+
+    // the levers must be released before the door closes; put them back afterwards
+    bool released1 = lever_wait(ld->lever1, deadline);
+    bool released2 = lever_wait(ld->lever2, deadline);
+    if (released1) sem_post(ld->lever1);
+    if (released2) sem_post(ld->lever2);
+
+    return held1 && held2 && copied && released1 && released2;
+}
+
+bool local_dungeon_play(struct LocalDungeon *ld, const struct RoundInput *in) {
+    uint64_t reaction = 0;
+    bool ok = false;
+    switch (in->type) {
+    case ROUND_MONSTER:  ok = round_monster(ld, in->health, &reaction); break;
+    case ROUND_BARRIER:  ok = round_barrier(ld, in, &reaction); break;
+    case ROUND_TRAP:     ok = round_trap(ld, in->target, &reaction); break;
+    case ROUND_TREASURE: ok = round_treasure(ld, in->treasure, &reaction); break;
+    default: return false;
+    }
+    record(ld, in->type, ok, reaction);
+    log_judged(ld, ld->roundNo, ok, ok ? ld->roundNs + reaction : dungeon_now_ns());
+    if (ld->cfg.verbose) {
+        printf("[Dungeon] %s round: %s (%.1f us)\n", local_dungeon_round_name(in->type),
+               ok ? "SUCCESS" : "FAILURE", (double)reaction / 1000.0);
+    }
+    return ok;
+}
+
+// Random inputs, drawn in the same order as before so a seed replays the same rounds
+static bool draw_round(struct LocalDungeon *ld, enum RoundType type, struct RoundInput *out) {
+    struct RoundInput in;
+    memset(&in, 0, sizeof(in));
+    in.type = type;
+    switch (type) {
+    case ROUND_MONSTER:
+        in.health = rand_r(&ld->rng);
+        break;
+    case ROUND_BARRIER: {
+        const char *phrase = spell_phrases[rand_r(&ld->rng) % SPELL_NUM_PHRASES];
+        char key = letters[rand_r(&ld->rng) % (sizeof(letters) - 1)];
+        int shift = ((unsigned char)key) % 26;
+        size_t n = 0;
+        in.spell[n++] = key;
+        for (const char *p = phrase; *p && n < sizeof(in.spell) - 1; ++p) {
+            in.spell[n++] = caesar_encode(*p, shift);
+        }
+        snprintf(in.answer, sizeof(in.answer), "%s", phrase);
+        break;
+    }
+    case ROUND_TRAP:
+        in.target = (float)(rand_r(&ld->rng) % MAX_PICK_ANGLE);
+        break;
+    case ROUND_TREASURE:
+        for (int i = 0; i < 4; ++i) {
+            in.treasure[i] = letters[rand_r(&ld->rng) % 26];
+        }
+        break;
+    default:
+        return false;
+    }
+    *out = in;
+    return true;
+}
+
+bool local_dungeon_round(struct LocalDungeon *ld, enum RoundType type) {
+    struct RoundInput in;
+    return draw_round(ld, type, &in) && local_dungeon_play(ld, &in);
+}
+
+// ---- queue mode ----
+
+struct QueuedRound {
+    struct RoundInput in;
+    bool judged;
+    uint32_t logged; // its number in the round log
+};
+
+// Log a queued round's input, posted at t
+static uint32_t log_queued(struct LocalDungeon *ld, const struct RoundInput *in, uint64_t t) {
+    if (in->type == ROUND_MONSTER) return log_published(ld, t, LOG_HEALTH, in->health, NULL, 0);
+    return log_published(ld, t, LOG_SPELL, 0, in->spell, spell_log_len(in->spell));
+}
+
+// A queued round that could not be posted: logged and judged a failure at once
+static void queued_failed(struct LocalDungeon *ld, struct QueuedRound *r) {
+    uint64_t now = dungeon_now_ns();
+    record(ld, r->in.type, false, 0);
+    log_judged(ld, log_queued(ld, &r->in, now), false, now);
+    r->judged = true;
+}
+
+// Post a burst of monster and barrier rounds as commands, one doorbell ring per role, then judge
+// the completions as they come back. Completions of an earlier burst that ran out of time only
+// give their room back.
+static void play_burst(struct LocalDungeon *ld, struct QueuedRound *burst, uint32_t n) {
+    struct RoleQueue *queues[2] = { dungeon_queue(ld->queues, ROLE_BARBARIAN), dungeon_queue(ld->queues, ROLE_WIZARD) };
+    struct QueueCompletion done[QUEUE_DEPTH];
+    for (int k = 0; k < 2; ++k) {
+        while (queue_reap(queues[k], done, QUEUE_DEPTH) > 0) {
+        }
+    }
+
+    uint32_t first = ld->nextRound;
+    ld->nextRound += n;
+    struct QueueCommand cmds[2][QUEUE_DEPTH];
+    uint32_t count[2] = { 0, 0 };
+    uint32_t room[2] = { queue_room(queues[0]), queue_room(queues[1]) };
+    uint32_t open = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        struct QueuedRound *r = &burst[i];
+        struct QueueCommand c = { .round = first + i };
+        int k = r->in.type == ROUND_MONSTER ? 0 : 1;
+        if (count[k] == room[k]) {
+            // a crashed role took commands and never answered them: this one could not be posted,
+            // and for a barrier its record must not overwrite one that may still be decoding
+            queued_failed(ld, r);
+            continue;
+        }
+        if (k == 0) {
+            c.type = QUEUE_ATTACK;
+            c.value = r->in.health;
+        } else {
+            size_t length;
+            c.type = QUEUE_DECODE;
+            if (!ld->spells || !arena_write_spell(ld, &r->in, &c.ref, &length)) {
+                queued_failed(ld, r);
+                continue;
+            }
+            c.length = (uint32_t)length;
+        }
+        cmds[k][count[k]++] = c;
+        ++open;
+    }
+    uint64_t start = dungeon_now_ns();
+    if (count[0] && queue_post(queues[0], cmds[0], count[0]) > 0) doorbell_ring(ld->dungeon, ROLE_BARBARIAN, DOORBELL_QUEUE);
+    if (count[1] && queue_post(queues[1], cmds[1], count[1]) > 0) doorbell_ring(ld->dungeon, ROLE_WIZARD, DOORBELL_QUEUE);
+    ld->bursts++;
+    for (uint32_t i = 0; i < n; ++i) {
+        if (!burst[i].judged) burst[i].logged = log_queued(ld, &burst[i].in, start);
+    }
+
+    long windowUs = ld->cfg.attackUs > ld->cfg.barrierUs ? ld->cfg.attackUs : ld->cfg.barrierUs;
+    uint64_t deadline = start + (uint64_t)windowUs * 1000ull;
+    while (open > 0 && dungeon_now_ns() < deadline) {
+        uint32_t got = 0;
+        for (int k = 0; k < 2; ++k) {
+            uint32_t m = queue_reap(queues[k], done, QUEUE_DEPTH);
+            uint64_t now = dungeon_now_ns();
+            for (uint32_t j = 0; j < m; ++j) {
+                const struct QueueCompletion *c = &done[j];
+                uint32_t i = c->round - first;
+                if (i >= n || burst[i].judged) continue; // an earlier burst's
+                struct QueuedRound *r = &burst[i];
+                bool ok = c->status == QUEUE_STATUS_DONE;
+                if (ok && r->in.type == ROUND_MONSTER) {
+                    ok = c->value == r->in.health;
+                } else if (ok) {
+                    ok = c->ref < ld->spells->capacity && c->length <= ld->spells->capacity - c->ref &&
+                         spell_matches(ld, &r->in, (const char *)ld->spells->records + c->ref, c->length);
+                }
+                record(ld, r->in.type, ok, now - start);
+                log_judged(ld, r->logged, ok, now);
+                stats_add(&ld->commands, ok, c->doneNs - start);
+                r->judged = true;
+                --open;
+                if (ld->cfg.verbose) {
+                    printf("[Dungeon] queued %s round %u: %s (%.1f us)\n", local_dungeon_round_name(r->in.type),
+                           c->round, ok ? "SUCCESS" : "FAILURE", (double)(now - start) / 1000.0);
+                }
+            }
+            got += m;
+        }
+        if (got == 0 && open > 0) pause_us(ld->cfg.pollUs);
+    }
+    for (uint32_t i = 0; i < n; ++i) {
+        if (burst[i].judged) continue;
+        record(ld, burst[i].in.type, false, 0);
+        log_judged(ld, burst[i].logged, false, dungeon_now_ns());
+    }
+}
+
+void local_dungeon_run(struct LocalDungeon *ld) {
+    enum RoundType allowed[3];
+    int nallowed = 0;
+    if (ALLOW_BARBARIAN) allowed[nallowed++] = ROUND_MONSTER;
+    if (ALLOW_WIZARD) allowed[nallowed++] = ROUND_BARRIER;
+    if (ALLOW_ROGUE) allowed[nallowed++] = ROUND_TRAP;
+
+    // queue mode: monster and barrier rounds wait in a burst, a trap round plays the burst first
+    uint32_t batch = ld->cfg.queueBatch > (int)QUEUE_DEPTH ? QUEUE_DEPTH : (uint32_t)(ld->cfg.queueBatch > 0 ? ld->cfg.queueBatch : 0);
+    if (!ld->queues) batch = 0; // no queues to post to: every round is played one by one
+    struct QueuedRound burst[QUEUE_DEPTH]; // per run: the party runs one per thread
+    uint32_t queued = 0;
+
+    ld->startNs = dungeon_now_ns();
+    for (int i = 0; i < ld->cfg.rounds && nallowed > 0 && dungeon_running(ld->dungeon); ++i) {
+        enum RoundType type = allowed[rand_r(&ld->rng) % (unsigned)nallowed];
+        if (batch == 0 || type == ROUND_TRAP) {
+            if (queued) play_burst(ld, burst, queued);
+            queued = 0;
+            local_dungeon_round(ld, type);
+            continue;
+        }
+        memset(&burst[queued], 0, sizeof(burst[queued]));
+        if (!draw_round(ld, type, &burst[queued].in)) continue;
+        if (++queued == batch) {
+            play_burst(ld, burst, queued);
+            queued = 0;
+        }
+    }
+    if (queued && dungeon_running(ld->dungeon)) play_burst(ld, burst, queued);
+    for (int i = 0; i < ld->cfg.treasureRounds && dungeon_running(ld->dungeon); ++i) {
+        local_dungeon_round(ld, ROUND_TREASURE);
+    }
+    ld->endNs = dungeon_now_ns();
+}
+
+void local_dungeon_report(struct LocalDungeon *ld, FILE *out) {
+    unsigned total = 0;
+    for (int t = 0; t < NUM_ROUND_TYPES; ++t) {
+        total += ld->stats[t].attempts;
+    }
+    double secs = (double)(ld->endNs - ld->startNs) / 1e9;
+    fprintf(out, "[Dungeon] %u rounds in %.3f s (%.1f rounds/s), notify: %s\n", total, secs,
+            secs > 0 ? (double)total / secs : 0.0, ld->cfg.useSignals ? "signals" : "doorbell");
+
+    for (int t = 0; t < NUM_ROUND_TYPES; ++t) {
+        struct RoundStats *s = &ld->stats[t];
+        if (s->attempts == 0) continue;
+        fprintf(out, "  %-8s %u/%u (%.1f%%)", local_dungeon_round_name(t), s->successes, s->attempts,
+                100.0 * (double)s->successes / (double)s->attempts);
+        if (s->sampleCount > 0) {
+            double p50 = (double)dungeon_percentile(s->samples, s->sampleCount, 50.0) / 1000.0;
+            double p99 = (double)dungeon_percentile(s->samples, s->sampleCount, 99.0) / 1000.0;
+            fprintf(out, "  reaction p50=%.1fus p99=%.1fus max=%.1fus", p50, p99,
+                    (double)s->reaction.maxNs / 1000.0);
+        }
+        fprintf(out, "\n");
+        if (t == ROUND_BARRIER && ld->spells && ld->cfg.spellBytes && s->sampleCount > 0 && !ld->cfg.queueBatch) {
+            double p50 = (double)dungeon_percentile(s->samples, s->sampleCount, 50.0);
+            fprintf(out, "           %zu-byte spells, p50 %.3f ns/byte (%.2f GB/s)\n", ld->cfg.spellBytes,
+                    p50 / (double)ld->cfg.spellBytes, (double)ld->cfg.spellBytes / p50);
+        }
+        if (latency_histograms_enabled()) {
+            latency_histogram_print(out, "      ", &s->reaction);
+        }
+    }
+    if (ld->cfg.queueBatch > 0 && ld->commands.attempts > 0) {
+        struct RoundStats *c = &ld->commands;
+        fprintf(out, "  queue    %u commands in %llu bursts, posted -> completed p50=%.1fus p99=%.1fus\n",
+                c->attempts, (unsigned long long)ld->bursts,
+                c->sampleCount ? (double)dungeon_percentile(c->samples, c->sampleCount, 50.0) / 1000.0 : 0.0,
+                c->sampleCount ? (double)dungeon_percentile(c->samples, c->sampleCount, 99.0) / 1000.0 : 0.0);
+    }
+    fflush(out);
+}
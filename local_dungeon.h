@@ -0,0 +1,106 @@
+#ifndef LOCAL_DUNGEON_H
+#define LOCAL_DUNGEON_H
+//Open-source stand-in for RunDungeon(). It plays the same rounds against the same shared
+//struct Dungeon (monster, barrier, trap and the treasure room with the two levers), but with
+//configurable timing windows, so the roles can be driven thousands of rounds per second.
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <semaphore.h>
+#include <sys/types.h>
+
+#include "dungeon_info.h"
+#include "dungeon_clock.h"
+#include "spell_arena.h"
+
+enum RoundType{
+	ROUND_MONSTER = 0,
+	ROUND_BARRIER = 1,
+	ROUND_TRAP = 2,
+	ROUND_TREASURE = 3,
+	NUM_ROUND_TYPES = 4
+};
+
+struct LocalDungeonConfig{
+	int rounds;          //monster/barrier/trap rounds, picked at random like RunDungeon()
+	int treasureRounds;  //treasure rooms played after the other rounds
+	bool useSignals;     //notify roles with DUNGEON_SIGNAL/SEMAPHORE_SIGNAL instead of their doorbell
+	bool verbose;        //print every round
+	long attackUs;       //SECONDS_TO_ATTACK
+	long barrierUs;      //SECONDS_TO_GUESS_BARRIER
+	long pickUs;         //SECONDS_TO_PICK
+	long tickUs;         //TIME_BETWEEN_ROGUE_TICKS
+	long treasureUs;     //TIME_TREASURE_AVAILABLE
+	long pollUs;         //how often the dungeon looks at the roles' answers
+	size_t spellBytes;   //large-spell mode: barrier texts of this many bytes in the spell arena
+	int queueBatch;      //queue mode: monster and barrier rounds go out as commands this many at a time
+	unsigned seed;
+};
+
+struct RoundStats{
+	unsigned attempts;
+	unsigned successes;
+	struct LatencyStats reaction; //notify -> correct answer visible
+	uint64_t *samples;            //every successful reaction, for percentiles
+	size_t sampleCount;
+	size_t sampleCap;
+};
+
+struct LocalDungeon{
+	struct Dungeon *dungeon;
+	pid_t pids[NUM_ROLES];  //0 for roles that are not separate processes
+	sem_t *lever1;          //NULL skips the treasure room
+	sem_t *lever2;
+	struct LocalDungeonConfig cfg;
+	struct SpellArena *spells; //large-spell mode (cfg.spellBytes), set by the caller
+	struct DungeonQueues *queues; //queue mode (cfg.queueBatch), set by the caller
+	struct DungeonLogWriter *log; //every round as it is published and judged (dungeon_log.h), NULL for
+	                              //none; set by the caller
+	uint32_t loggedRounds;        //rounds in the log so far
+	uint32_t roundNo;             //the current round's number in the log
+	uint64_t roundNs;             //when the current round was published
+	char *plain;               //large-spell mode: the current barrier's plaintext
+	unsigned rng;
+	uint64_t startNs;
+	uint64_t endNs;
+	struct RoundStats stats[NUM_ROUND_TYPES];
+	struct RoundStats commands; //queue mode: posted -> completed, as stamped by the role
+	uint32_t nextRound;         //queue mode: round number of the next command
+	uint64_t bursts;
+};
+
+//Defaults: the windows from dungeon_settings.h, or millisecond-scale windows in turbo mode.
+void local_dungeon_defaults(struct LocalDungeonConfig *cfg, bool turbo);
+
+//Bytes of spell arena (spell_arena.h) the configuration needs, 0 for none. The caller creates it
+//and sets spells after local_dungeon_init().
+size_t local_dungeon_arena_capacity(const struct LocalDungeonConfig *cfg);
+
+void local_dungeon_init(struct LocalDungeon *ld, struct Dungeon *d, const pid_t pids[NUM_ROLES],
+                        sem_t *lever1, sem_t *lever2, const struct LocalDungeonConfig *cfg);
+
+//Inputs of one round. local_dungeon_round() draws them at random; a replay (dungeon_replay.c)
+//takes them from a recorded run.
+struct RoundInput{
+	enum RoundType type;
+	int health;                        //monster
+	char spell[SPELL_BUFFER_SIZE + 1]; //barrier: key character, then the encoded phrase
+	char answer[SPELL_BUFFER_SIZE];    //barrier: the plaintext that beats it
+	float target;                      //trap: the angle that opens the lock
+	char treasure[4];                  //treasure room
+};
+
+//Play one round of the given type. Returns true if the party beat it.
+bool local_dungeon_round(struct LocalDungeon *ld, enum RoundType type);
+
+//Play one round with the given inputs, recorded in the stats like any other.
+bool local_dungeon_play(struct LocalDungeon *ld, const struct RoundInput *in);
+
+//Play cfg.rounds random rounds followed by cfg.treasureRounds treasure rooms.
+void local_dungeon_run(struct LocalDungeon *ld);
+
+void local_dungeon_report(struct LocalDungeon *ld, FILE *out);
+void local_dungeon_free(struct LocalDungeon *ld);
+
+const char *local_dungeon_round_name(enum RoundType type);
+#endif
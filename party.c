@@ -0,0 +1,212 @@
+// party.c
+// The whole party in one process: the barbarian, wizard and rogue run as threads (roles.c)
+// against a local dungeon loop (local_dungeon.c) over an anonymous struct Dungeon mapping.
+// No signals, no named objects and no process switches, so it shows how much of the round
+// latency the three-process design costs, and many parties can run side by side (-N).
+
+#define _DEFAULT_SOURCE // syscall() for the doorbell futex
+
+#include <stdio.h> // printf()
+#include <stdlib.h> // atoi(), calloc()
+#include <string.h> // memset()
+#include <unistd.h> // getopt()
+#include <pthread.h> // role and dungeon threads
+#include <semaphore.h> // unnamed levers
+#include <sys/mman.h> // anonymous mapping
+
+#include "dungeon_info.h" // struct Dungeon
+#include "dungeon_doorbell.h" // doorbell_ring()
+#include "dungeon_atomic.h" // dungeon_set_running()
+#include "dungeon_attach.h" // dungeon_wait_ready()
+#include "local_dungeon.h" // the round engine
+#include "roles.h" // role handlers and role_thread_main()
+
+struct Party {
+    struct Dungeon *dungeon;
+    sem_t levers[2]; // process-private stand-ins for /LeverOne and /LeverTwo
+    sem_t spoilsReady; // and for /SpoilsReady
+    struct RoleContext roles[NUM_ROLES];
+    struct SpellCache spellCache; // the wizard's
+    struct SpellArena *spells; // -L: large spells, in an anonymous mapping
+    struct SpellWorkers spellWorkers; // the wizard's threads for them
+    struct DungeonQueues *queues; // -Q: command queues, in an anonymous mapping
+    pthread_t threads[NUM_ROLES];
+    pthread_t loop;
+    struct LocalDungeon ld;
+    uint64_t launchNs;
+    uint64_t readyNs;
+};
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-t] [-v] [-N parties] [-n rounds] [-T treasure_rooms] [-S seed] [-L spell_bytes] [-Q batch]\n"
+            "          [-a attack_us] [-b barrier_us] [-p pick_us] [-k tick_us] [-r treasure_us] [-P poll_us]\n"
+            "  -t  turbo: millisecond windows instead of the ones in dungeon_settings.h\n"
+            "  -v  print every round and every role action\n"
+            "  -N  number of parties to run at the same time (default 1)\n"
+            "  -L  large-spell mode: barrier spells of this many bytes in a spell arena\n"
+            "  -Q  queue mode: monster and barrier rounds go to the roles' command queues, this many at a time\n",
+            prog);
+}
+
+// one dungeon thread per party: wait for its roles, play, then shut them down
+static void *party_main(void *arg) {
+    struct Party *p = arg;
+    struct Dungeon *d = p->dungeon;
+    if (dungeon_wait_ready(d, NUM_ROLES, 5000) < NUM_ROLES) {
+        fprintf(stderr, "party: not every role became ready, starting anyway\n");
+    }
+    p->readyNs = dungeon_now_ns();
+
+    local_dungeon_run(&p->ld);
+
+    dungeon_set_running(d, false);
+    for (int r = 0; r < NUM_ROLES; ++r) {
+        doorbell_ring(d, r, DOORBELL_SHUTDOWN);
+    }
+    for (int r = 0; r < NUM_ROLES; ++r) {
+        pthread_join(p->threads[r], NULL);
+    }
+    return NULL;
+}
+
+static int party_start(struct Party *p, const struct LocalDungeonConfig *cfg, bool verbose) {
+    p->launchNs = dungeon_now_ns();
+    p->dungeon = mmap(NULL, sizeof(struct Dungeon), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (p->dungeon == MAP_FAILED) {
+        perror("party mmap");
+        return -1;
+    }
+    struct Dungeon *d = p->dungeon;
+    memset(d, 0, sizeof(*d));
+    for (int r = 0; r < NUM_ROLES; ++r) {
+        d->doorbell.eventFd[r] = -1; // threads wait on the futex only
+    }
+    d->dungeonPID = getpid();
+    dungeon_set_running(d, true);
+
+    sem_init(&p->levers[0], 0, 1);
+    sem_init(&p->levers[1], 0, 1);
+    sem_init(&p->spoilsReady, 0, 0);
+    pid_t none[NUM_ROLES] = { 0, 0, 0 }; // no pids: the local dungeon rings doorbells
+    local_dungeon_init(&p->ld, d, none, &p->levers[0], &p->levers[1], cfg);
+    size_t arenaBytes = local_dungeon_arena_capacity(cfg);
+    if (arenaBytes) {
+        p->spells = spell_arena_create_private(arenaBytes);
+        if (!p->spells) {
+            perror("party spell arena");
+            return -1;
+        }
+        p->ld.spells = p->spells;
+    }
+    if (cfg->queueBatch > 0) {
+        p->queues = mmap(NULL, sizeof(struct DungeonQueues), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (p->queues == MAP_FAILED) {
+            p->queues = NULL;
+            perror("party queues");
+            return -1;
+        }
+        p->ld.queues = p->queues;
+    }
+
+    for (int r = 0; r < NUM_ROLES; ++r) {
+        role_context_init(&p->roles[r], d, r);
+        p->roles[r].quiet = !verbose;
+        p->roles[r].lever1 = &p->levers[0];
+        p->roles[r].lever2 = &p->levers[1];
+        p->roles[r].spoilsReady = &p->spoilsReady;
+        p->roles[r].queues = p->queues;
+        if (r == ROLE_WIZARD) wizard_use_spell_cache(&p->roles[r], &p->spellCache);
+        if (r == ROLE_WIZARD && p->spells) wizard_use_spell_arena(&p->roles[r], p->spells, &p->spellWorkers);
+        if (pthread_create(&p->threads[r], NULL, role_thread_main, &p->roles[r]) != 0) {
+            perror("party pthread_create");
+            return -1;
+        }
+    }
+    if (pthread_create(&p->loop, NULL, party_main, p) != 0) {
+        perror("party pthread_create");
+        return -1;
+    }
+    return 0;
+}
+
+static void party_free(struct Party *p) {
+    local_dungeon_free(&p->ld);
+    spell_arena_close(p->spells);
+    if (p->queues) munmap(p->queues, sizeof(struct DungeonQueues));
+    sem_destroy(&p->levers[0]);
+    sem_destroy(&p->levers[1]);
+    sem_destroy(&p->spoilsReady);
+    munmap(p->dungeon, sizeof(struct Dungeon));
+}
+
+int main(int argc, char **argv) {
+    // turbo changes the defaults, so look for it before the other options
+    bool turbo = false;
+    for (int i = 1; i < argc; ++i) {
+        if (argv[i][0] == '-' && argv[i][1] == 't') turbo = true;
+    }
+    struct LocalDungeonConfig cfg;
+    local_dungeon_defaults(&cfg, turbo);
+    int parties = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "tvN:n:T:S:L:Q:a:b:p:k:r:P:")) != -1) {
+        switch (opt) {
+        case 't': break;
+        case 'v': cfg.verbose = true; break;
+        case 'N': parties = atoi(optarg); break;
+        case 'n': cfg.rounds = atoi(optarg); break;
+        case 'T': cfg.treasureRounds = atoi(optarg); break;
+        case 'S': cfg.seed = (unsigned)atol(optarg); break;
+        case 'L': cfg.spellBytes = (size_t)atoll(optarg); break;
+        case 'Q': cfg.queueBatch = atoi(optarg); break;
+        case 'a': cfg.attackUs = atol(optarg); break;
+        case 'b': cfg.barrierUs = atol(optarg); break;
+        case 'p': cfg.pickUs = atol(optarg); break;
+        case 'k': cfg.tickUs = atol(optarg); break;
+        case 'r': cfg.treasureUs = atol(optarg); break;
+        case 'P': cfg.pollUs = atol(optarg); break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if (parties < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    struct Party *all = calloc((size_t)parties, sizeof(*all));
+    if (!all) {
+        perror("party calloc");
+        return 1;
+    }
+    uint64_t start = dungeon_now_ns();
+    int started = 0;
+    for (; started < parties; ++started) {
+        struct LocalDungeonConfig c = cfg;
+        c.seed = cfg.seed + (unsigned)started; // different rounds per party
+        if (party_start(&all[started], &c, cfg.verbose) != 0) break;
+    }
+
+    unsigned rounds = 0;
+    for (int i = 0; i < started; ++i) {
+        pthread_join(all[i].loop, NULL);
+    }
+    double secs = (double)(dungeon_now_ns() - start) / 1e9;
+    for (int i = 0; i < started; ++i) {
+        struct Party *p = &all[i];
+        printf("[Party %d] ready in %.2fms\n", i, (double)(p->readyNs - p->launchNs) / 1e6);
+        local_dungeon_report(&p->ld, stdout);
+        wizard_spell_cache_report(&p->roles[ROLE_WIZARD]);
+        wizard_spell_arena_close(&p->roles[ROLE_WIZARD]);
+        for (int t = 0; t < NUM_ROUND_TYPES; ++t) {
+            rounds += p->ld.stats[t].attempts;
+        }
+        party_free(p);
+    }
+    printf("[Party] %d parties, %u rounds in %.3f s (%.1f rounds/s)\n", started, rounds, secs,
+           secs > 0 ? (double)rounds / secs : 0.0);
+    free(all);
+    return started == parties ? 0 : 1;
+}
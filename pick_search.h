@@ -0,0 +1,55 @@
+#ifndef PICK_SEARCH_H
+#define PICK_SEARCH_H
+//Bisection search for the rogue's lock pick, driven by the dungeon's trap.direction feedback:
+//'u' means the lock angle is above the pick, 'd' below it, '-' means the lock is open.
+//Takes about log2(MAX_PICK_ANGLE / LOCK_THRESHOLD) verdicts, so harder locks cost only a few more ticks.
+#include "dungeon_settings.h"
+
+//Written by the rogue next to each new pick. The dungeon overwrites it with its verdict, so a
+//value other than this one is feedback for the newest pick. The dungeon uses 'w' itself while
+//it waits for the first pick.
+#define PICK_AWAITING_VERDICT 'w'
+
+struct PickSearch{
+	float low;      //lock angle is known to be >= low
+	float high;     //lock angle is known to be <= high
+	float guess;    //pick currently shown to the dungeon
+	float maxAngle;
+	float threshold;
+	unsigned ticks; //verdicts received so far
+	unsigned restarts; //times the bracket had to be reset after inconsistent feedback
+};
+
+static inline void pick_search_init(struct PickSearch *s, float maxAngle, float threshold){
+	s->low = 0.0f;
+	s->high = maxAngle;
+	s->guess = maxAngle / 2.0f;
+	s->maxAngle = maxAngle;
+	s->threshold = threshold;
+	s->ticks = 0;
+	s->restarts = 0;
+}
+
+//Feed the verdict for s->guess and return the next pick to show.
+static inline float pick_search_feedback(struct PickSearch *s, char direction){
+	s->ticks++;
+	if (direction == 'u') {
+		s->low = s->guess;
+	} else if (direction == 'd') {
+		s->high = s->guess;
+	} else {
+		return s->guess; //'-' (open) or unknown: keep the pick where it is
+	}
+
+	//Once the bracket is narrower than the tolerance, the midpoint must already have opened
+	//the lock. Still being told to move means a verdict was stale (it was for an older pick),
+	//so the lock angle may be outside the bracket: start over on the full range.
+	if (s->high - s->low < s->threshold) {
+		s->low = 0.0f;
+		s->high = s->maxAngle;
+		s->restarts++;
+	}
+	s->guess = s->low + (s->high - s->low) / 2.0f;
+	return s->guess;
+}
+#endif
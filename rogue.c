@@ -14,6 +14,10 @@
 
 #include "dungeon_info.h"  //shared dungeon and semaphore names 
 #include "dungeon_settings.h" // gameplay values and signal settings 
+#include "dungeon_runtime.h" // signalfd/epoll event loop 
+#include "dungeon_atomic.h" // dungeon_running(), dungeon_trap_locked() 
+#include "dungeon_attach.h" // dungeon_attach(), dungeon_mark_ready() 
+#include "roles.h" // rogue_pick_lock(), rogue_collect_treasure(), shared with the party 
 
 #ifndef DUNGEON_SIGNAL //dungeon uses it to send trap updates 
 #define DUNGEON_SIGNAL   SIGUSR1   // regular dungeon ping (traps)
@@ -25,130 +29,52 @@
 
 static struct Dungeon *dungeon = NULL; // pointer to the shared dungeon struct
 
-// Flags set by signal handler:
-static volatile sig_atomic_t got_dungeon_signal   = 0;
-static volatile sig_atomic_t got_semaphore_signal = 0;
-
-static void pick_lock(void) {
-    if (!dungeon) return; // shared memory must be valid 
-
-    while (dungeon->running && dungeon->trap.locked) { 
-        float pick = dungeon->rogue.pick; // read current pick angle 
-
-        // Move the pick forward by 1 each iteration, wrap at MAX_PICK_ANGLE
-        pick += 1.0f;// advance pick by 1 degree 
-        if (pick > (float)MAX_PICK_ANGLE) { // wrap around if exceeds max angle 
-            pick = 0.0f;
-        }
-
-        dungeon->rogue.pick = pick; // write updated pick angle into shared memory 
-
-        // Let the dungeon see the update
-        usleep(TIME_BETWEEN_ROGUE_TICKS / 2);
-    }
-}
-
-static void handle_treasure(void) { 
-    if (!dungeon) return; // safety check 
-
-    printf("[Rogue] Starting treasure collection...\n");
-    fflush(stdout);
-
-    // Give the dungeon time to fully populate the treasure.
-    // Barbarian holds the door open for TIME_TREASURE_AVAILABLE seconds.
-    // We wait until near the end, then copy all 4 chars at once.
-    if (TIME_TREASURE_AVAILABLE > 2) {
-        sleep(TIME_TREASURE_AVAILABLE - 2);  // e.g., 8 seconds if TIME_TREASURE_AVAILABLE = 10
-    }
-
-    // Copy all 4 treasure bytes into spoil buffer 
-    memcpy(dungeon->spoils, dungeon->treasure, sizeof(dungeon->spoils));
-
-// debug printing 
-    printf("[Rogue] Final treasure values:\n");
-    for (int i = 0; i < 4; ++i) {
-        char c = dungeon->spoils[i];
-        printf("  spoils[%d] = '%c'\n", i, c ? c : ' ');
-    }
-// print the final 4 character
-    printf("[Rogue] Finished treasure: %c%c%c%c\n",
-           dungeon->spoils[0],
-           dungeon->spoils[1],
-           dungeon->spoils[2],
-           dungeon->spoils[3]);
-    fflush(stdout);
-}
-
-//signla handler 
-static void rogue_handler(int sig) {
-    if (sig == DUNGEON_SIGNAL) {
-        got_dungeon_signal = 1; // trap update signal 
-    } else if (sig == SEMAPHORE_SIGNAL) {
-        got_semaphore_signal = 1; // treasure signal 
-    }
-}
-
 int main(void) {
+    dungeon_rt_apply("Rogue", ROLE_ROGUE); // only with DUNGEON_RT set 
+
     // Attach to shared memory created by the dungeon/game.
-    int fd = -1;
-    for (int tries = 0; tries < 50 && fd == -1; ++tries) {
-        fd = shm_open(dungeon_shm_name, O_RDWR, 0666);
-        if (fd == -1) {
-            usleep(100000); // 0.1 s
-        }
-    }
-    if (fd == -1) {// failed after retries 
-        perror("rogue shm_open");
+    dungeon = dungeon_attach("rogue");
+    if (!dungeon) {// failed after retries 
         return EXIT_FAILURE;
     }
-// map the shared memory into this process 
-    dungeon = mmap(NULL, sizeof(*dungeon),
-                   PROT_READ | PROT_WRITE, // need both read and write 
-                   MAP_SHARED, // share updates with other processes 
-                   fd,
-                   0);
-    close(fd);
-//check map succeded 
-    if (dungeon == MAP_FAILED) {
-        perror("rogue mmap");
-        return EXIT_FAILURE;
+    if (!dungeon_standby_wait(dungeon, ROLE_ROGUE)) { // a hot standby that was never promoted 
+        munmap(dungeon, sizeof(struct Dungeon));
+        return EXIT_SUCCESS;
     }
 
-    // Set up signal handlers for both dungeon and semaphore signals.
-    struct sigaction sa;
-    memset(&sa, 0, sizeof(sa));
-    sa.sa_handler = rogue_handler; // the function we call 
-    sigemptyset(&sa.sa_mask); // do no block other signals 
-    sa.sa_flags = 0; // default behavious 
-
-// handles dungeon trap signals 
-    if (sigaction(DUNGEON_SIGNAL, &sa, NULL) == -1) {
-        perror("rogue sigaction(DUNGEON_SIGNAL)");
-    }
-    if (sigaction(SEMAPHORE_SIGNAL, &sa, NULL) == -1) {
-        perror("rogue sigaction(SEMAPHORE_SIGNAL)");
+    // Dungeon and semaphore signals are read through a signalfd in the role runtime.
+    struct RoleRuntime rt;
+    if (role_runtime_open(&rt, dungeon, ROLE_ROGUE) == -1) {
+        perror("rogue role runtime");
     }
+    dungeon_mark_ready(dungeon, ROLE_ROGUE);
+
+    struct RoleContext ctx;
+    role_context_init(&ctx, dungeon, ROLE_ROGUE);
+    ctx.stats = rt.stats; // live metrics for dungeonstat, NULL without the stats extension 
+    ctx.trace = rt.trace; // event ring, NULL unless DUNGEON_TRACE is set 
 
-    // Main loop: respond to signals until dungeon stops running.
-    while (dungeon->running) {
-        pause();  // sleep until signal arrives
+    // Main loop: respond to the doorbell until dungeon stops running.
+    while (dungeon_running(dungeon)) {
+        uint32_t bits = role_runtime_wait(&rt, -1); // sleep until a signal or the doorbell 
 
-        if (!dungeon->running) {
+        if (!dungeon_running(dungeon) || (bits & DOORBELL_SHUTDOWN)) {
             break; // dungeon is shutting down 
         }
 
-        if (got_dungeon_signal) {
-            got_dungeon_signal = 0;
-            if (dungeon->trap.locked) {
-                pick_lock();
+        if (bits & DOORBELL_ENCOUNTER) {
+            if (dungeon_trap_locked(dungeon)) {
+                rogue_pick_lock(&ctx);
+                role_runtime_done(&rt);
             }
         }
 // if a treasure signal arrives 
-        if (got_semaphore_signal) {
-            got_semaphore_signal = 0;
-            handle_treasure();
+        if (bits & DOORBELL_SEMAPHORE) {
+            rogue_collect_treasure(&ctx);
         }
     }
+    role_runtime_report(&rt, "Rogue");
+    role_runtime_close(&rt);
 // cleanup unmap shared memory before existing 
     munmap(dungeon, sizeof(*dungeon));
     return EXIT_SUCCESS;
@@ -0,0 +1,460 @@
+// roles.c
+// Handlers for the barbarian, wizard and rogue, shared by the role binaries and the party.
+#define _GNU_SOURCE // usleep(), syscall() for the doorbell futex, sem_clockwait()
+
+#include <errno.h> // EINTR
+#include <stdio.h> // printf()
+#include <stdlib.h> // getenv()
+#include <string.h> // memset()
+#include <time.h> // sem_clockwait() deadline
+#include <fcntl.h> // sem_open() flags
+#include <unistd.h> // usleep()
+
+#include "roles.h"
+#include "dungeon_settings.h" // timing windows, MAX_PICK_ANGLE, LOCK_THRESHOLD
+#include "dungeon_atomic.h" // acquire/release accessors and seqlock snapshots
+#include "dungeon_attach.h" // dungeon_mark_ready()
+#include "dungeon_doorbell.h" // doorbell_wait()
+#include "dungeon_clock.h" // dungeon_now_ns()
+#include "dungeon_names.h" // lever and /SpoilsReady names of this instance
+#include "pick_search.h" // bisection on the trap.direction feedback
+#include "spell_decode.h" // scalar/SSE2/AVX2 caesar decoder
+#include "spell_cache.h" // memoized decodes
+#include "spell_arena.h" // large spells
+#include "spell_workers.h" // parallel in-place decode
+#include "dungeon_queue.h" // queued encounters
+#include "spell_phrases.h" // warm-up pool
+
+static const char *const role_names[NUM_ROLES] = { "Wizard", "Rogue", "Barbarian" };
+
+void role_context_init(struct RoleContext *ctx, struct Dungeon *d, enum DungeonRole role) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->dungeon = d;
+    ctx->role = role;
+    ctx->name = role_names[role];
+}
+
+void role_context_close(struct RoleContext *ctx) {
+    if (ctx->ownsLevers) {
+        if (ctx->lever1 && ctx->lever1 != SEM_FAILED) sem_close(ctx->lever1);
+        if (ctx->lever2 && ctx->lever2 != SEM_FAILED) sem_close(ctx->lever2);
+        if (ctx->spoilsReady && ctx->spoilsReady != SEM_FAILED) sem_close(ctx->spoilsReady);
+        ctx->lever1 = ctx->lever2 = ctx->spoilsReady = NULL;
+        ctx->ownsLevers = false;
+    }
+}
+
+// /SpoilsReady, opened by name the first time a role needs it
+static sem_t *spoils_ready(struct RoleContext *ctx) {
+    if (!ctx->spoilsReady) {
+        ctx->spoilsReady = sem_open(dungeon_names()->spoilsReady, 0);
+        ctx->ownsLevers = true;
+        if (ctx->spoilsReady == SEM_FAILED) {
+            perror("sem_open spoils ready"); // game too old to create it: fall back to the full window
+        }
+    }
+    return ctx->spoilsReady == SEM_FAILED ? NULL : ctx->spoilsReady;
+}
+
+// Wait for sem until a dungeon_now_ns() deadline. Returns false on timeout.
+static bool sem_wait_until(sem_t *sem, uint64_t deadlineNs) {
+    // the same clock as the deadline, so a wall clock step cannot stretch or cut the window
+    struct timespec ts = { (time_t)(deadlineNs / 1000000000ull), (long)(deadlineNs % 1000000000ull) };
+    while (sem_clockwait(sem, CLOCK_MONOTONIC, &ts) == -1) {
+        if (errno != EINTR) return false;
+    }
+    return true;
+}
+
+// ---- barbarian ----
+
+// The local dungeon bumps a generation per monster, so each one is answered and timed once; the
+// prebuilt dungeon has none (generation 0), and then a changed enemy.health is the new monster.
+void barbarian_attack(struct RoleContext *ctx) {
+    struct Dungeon *d = ctx->dungeon;
+    trace_event(ctx->trace, TRACE_HANDLER_BEGIN, TRACE_ATTACK);
+    int health;
+    uint64_t publishedNs;
+    uint32_t gen = dungeon_watch_health(d, &health, &publishedNs);
+    for (;;) {
+        if (gen == 0 || gen != ctx->healthSeen) { // a ring for a monster already answered stores nothing
+            dungeon_store_attack(d, health); // the commit: one release store
+            trace_event(ctx->trace, TRACE_WRITE_ATTACK, (uint32_t)health);
+            if (gen != 0) {
+                uint64_t took = dungeon_now_ns() - publishedNs;
+                latency_record(&ctx->healthToAttack, took);
+                stat_record(ctx->stats, METRIC_ATTACK, took);
+                ctx->healthSeen = gen;
+            }
+        }
+        // a monster published while this one was committed is answered now, not after another wakeup
+        int next;
+        uint64_t nextNs;
+        uint32_t nextGen = dungeon_watch_health(d, &next, &nextNs);
+        if (nextGen == gen && next == health) break;
+        gen = nextGen;
+        health = next;
+        publishedNs = nextNs;
+    }
+    trace_event(ctx->trace, TRACE_HANDLER_END, TRACE_ATTACK);
+}
+
+void barbarian_pull_levers(struct RoleContext *ctx) {
+    struct Dungeon *d = ctx->dungeon;
+    trace_event(ctx->trace, TRACE_HANDLER_BEGIN, TRACE_LEVERS);
+    if (!ctx->lever1 || !ctx->lever2) { // both open levers
+        ctx->lever1 = sem_open(dungeon_names()->leverOne, 0);
+        ctx->lever2 = sem_open(dungeon_names()->leverTwo, 0);
+        ctx->ownsLevers = true;
+        if (ctx->lever1 == SEM_FAILED || ctx->lever2 == SEM_FAILED) { // error check for sem open
+            perror("barbarian: sem_open lever(s)");
+            role_context_close(ctx);
+            trace_event(ctx->trace, TRACE_HANDLER_END, TRACE_LEVERS);
+            return;
+        }
+    }
+    sem_t *done = spoils_ready(ctx);
+    if (done) {
+        while (sem_trywait(done) == 0) {
+            // a post left over from an earlier room must not open this one early
+        }
+    }
+    if (!ctx->quiet) {
+        printf("[%s] Received SEMAPHORE_SIGNAL (holding both levers)\n", ctx->name);
+        fflush(stdout);
+    }
+
+    // Pull both levers down (door opens)
+    trace_event(ctx->trace, TRACE_SEM_WAIT, TRACE_LEVER_ONE);
+    if (sem_wait(ctx->lever1) == -1) {
+        perror("barbarian: sem_wait lever1");
+    }
+    trace_event(ctx->trace, TRACE_SEM_ACQUIRED, TRACE_LEVER_ONE);
+    trace_event(ctx->trace, TRACE_SEM_WAIT, TRACE_LEVER_TWO);
+    if (sem_wait(ctx->lever2) == -1) {
+        perror("barbarian: sem_wait lever2");
+    }
+    trace_event(ctx->trace, TRACE_SEM_ACQUIRED, TRACE_LEVER_TWO);
+    uint64_t held = dungeon_now_ns();
+    if (!ctx->quiet) {
+        printf("[%s] Holding levers while Rogue gets treasure...\n", ctx->name);
+        fflush(stdout);
+    }
+
+    // Keep the door open until the Rogue has the treasure, but never past the window
+    uint64_t deadline = held + (uint64_t)TIME_TREASURE_AVAILABLE * 1000000000ull;
+    bool handedOff = false;
+    if (done) {
+        trace_event(ctx->trace, TRACE_SEM_WAIT, TRACE_SPOILS_READY);
+        handedOff = sem_wait_until(done, deadline);
+        trace_event(ctx->trace, TRACE_SEM_ACQUIRED, TRACE_SPOILS_READY);
+    } else {
+        while (dungeon_now_ns() < deadline) {
+            usleep(TIME_BETWEEN_ROGUE_TICKS); // no /SpoilsReady: hold for the whole window
+        }
+    }
+
+    // Release levers (door can close again)
+    if (sem_post(ctx->lever2) == -1) {
+        perror("barbarian: sem_post lever2");
+    }
+    trace_event(ctx->trace, TRACE_SEM_POST, TRACE_LEVER_TWO);
+    if (sem_post(ctx->lever1) == -1) {
+        perror("barbarian: sem_post lever1");
+    }
+    trace_event(ctx->trace, TRACE_SEM_POST, TRACE_LEVER_ONE);
+    uint64_t released = dungeon_now_ns();
+    latency_record(&ctx->leverHold, released - held);
+    stat_record(ctx->stats, METRIC_LEVER_HOLD, released - held);
+    uint64_t spoilsAt = atomic_load_explicit(&d->room.spoilsDoneNs, memory_order_acquire);
+    if (handedOff && spoilsAt != 0 && released >= spoilsAt) {
+        latency_record(&ctx->leverRelease, released - spoilsAt);
+    }
+    if (!ctx->quiet) {
+        printf("[%s] Released levers after %.1f ms (%s)\n", ctx->name, (double)(released - held) / 1e6,
+               handedOff ? "rogue has the treasure" : "treasure window ran out");
+        fflush(stdout);
+    }
+    trace_event(ctx->trace, TRACE_HANDLER_END, TRACE_LEVERS);
+}
+
+// ---- wizard ----
+
+// Large-spell mode: decode the arena's pending spell where it lies and publish the plaintext.
+// Returns false if there is none, so the barrier in struct Dungeon is the spell.
+static bool wizard_decode_arena(struct RoleContext *ctx, uint64_t start) {
+    uint64_t seq;
+    struct SpellRecord *r = spell_arena_pending(ctx->spellArena, &seq);
+    if (!r) return false;
+    char *spell = (char *)(r + 1);
+    size_t n = r->length ? r->length - 1 : 0; // the key byte is not part of the text
+    if (n) spell_workers_decode(ctx->spellWorkers, spell + 1, n, ((unsigned char)spell[0]) % 26);
+    spell_arena_answer(ctx->spellArena, seq, spell + 1, n);
+    trace_event(ctx->trace, TRACE_WRITE_SPELL, n > UINT32_MAX ? UINT32_MAX : (uint32_t)n);
+    if (ctx->stats) stat_record(ctx->stats, METRIC_DECODE, dungeon_now_ns() - start);
+    return true;
+}
+
+void wizard_decode_barrier(struct RoleContext *ctx) {
+    struct Dungeon *d = ctx->dungeon;
+    trace_event(ctx->trace, TRACE_HANDLER_BEGIN, TRACE_DECODE);
+    uint64_t start = ctx->stats ? dungeon_now_ns() : 0;
+    if (wizard_decode_arena(ctx, start)) {
+        trace_event(ctx->trace, TRACE_HANDLER_END, TRACE_DECODE);
+        return;
+    }
+
+    // decode from a consistent copy, never from a barrier the dungeon is still writing
+    char barrier[sizeof(d->barrier.spell)];
+    dungeon_read_barrier(d, barrier);
+
+    // first byte is the shift key, the rest is decoded with the fastest kernel this CPU has,
+    // unless the same spell was decoded before
+    size_t n;
+    if (ctx->spellCache) {
+        n = spell_cache_decode(ctx->spellCache, d->wizard.spell, sizeof(d->wizard.spell), barrier, sizeof(barrier));
+    } else {
+        n = spell_decode(d->wizard.spell, sizeof(d->wizard.spell), barrier, sizeof(barrier));
+    }
+    trace_event(ctx->trace, TRACE_WRITE_SPELL, (uint32_t)n);
+    if (ctx->stats) stat_record(ctx->stats, METRIC_DECODE, dungeon_now_ns() - start);
+    trace_event(ctx->trace, TRACE_HANDLER_END, TRACE_DECODE);
+}
+
+void wizard_use_spell_arena(struct RoleContext *ctx, struct SpellArena *arena, struct SpellWorkers *workers) {
+    spell_workers_init(workers, -1);
+    ctx->spellArena = arena;
+    ctx->spellWorkers = workers;
+}
+
+void wizard_spell_arena_close(struct RoleContext *ctx) {
+    struct SpellWorkers *w = ctx->spellWorkers;
+    if (!w) return;
+    printf("[%s] large spells: %llu split across %d threads, %llu decoded on one\n", ctx->name,
+           (unsigned long long)w->parallelJobs, w->count + 1, (unsigned long long)w->serialJobs);
+    fflush(stdout);
+    spell_workers_destroy(w);
+    ctx->spellWorkers = NULL;
+    ctx->spellArena = NULL;
+}
+
+void wizard_use_spell_cache(struct RoleContext *ctx, struct SpellCache *cache) {
+    spell_cache_init(cache);
+    ctx->spellCache = cache;
+    const char *warm = getenv("DUNGEON_SPELL_WARMUP");
+    if (!warm || !*warm) {
+        spell_cache_warm(cache, spell_phrases, SPELL_NUM_PHRASES);
+    } else if (strcmp(warm, "0") != 0 && spell_cache_warm_file(cache, warm) < 0) {
+        fprintf(stderr, "[%s] spell cache: can't read warm-up list %s, starting cold\n", ctx->name, warm);
+    }
+}
+
+void wizard_spell_cache_report(const struct RoleContext *ctx) {
+    const struct SpellCache *c = ctx->spellCache;
+    if (!c) return;
+    uint64_t total = c->hits + c->misses;
+    printf("[%s] spell cache: %llu hits, %llu misses (%.1f%% hit), %u entries, %llu evictions\n", ctx->name,
+           (unsigned long long)c->hits, (unsigned long long)c->misses,
+           total ? 100.0 * (double)c->hits / (double)total : 0.0, c->entries,
+           (unsigned long long)c->evictions);
+    fflush(stdout);
+}
+
+// ---- rogue ----
+
+// the pick goes in the ring as the bits of the float
+static void trace_pick(struct RoleContext *ctx, float pick) {
+    uint32_t bits;
+    memcpy(&bits, &pick, sizeof(bits));
+    trace_event(ctx->trace, TRACE_WRITE_PICK, bits);
+}
+
+void rogue_pick_lock(struct RoleContext *ctx) {
+    struct Dungeon *d = ctx->dungeon;
+    struct PickSearch search;
+    pick_search_init(&search, (float)MAX_PICK_ANGLE, (float)LOCK_THRESHOLD);
+    uint64_t start = dungeon_now_ns();
+    trace_event(ctx->trace, TRACE_HANDLER_BEGIN, TRACE_PICK);
+
+    // show the first pick, then only move it when the dungeon has judged the current one
+    dungeon_store_pick(d, search.guess);
+    trace_pick(ctx, search.guess);
+    dungeon_store_direction(d, PICK_AWAITING_VERDICT); // release: the pick lands first
+
+    while (dungeon_running(d) && dungeon_trap_locked(d)) {
+        char direction = dungeon_load_direction(d); // dungeon's verdict on the current pick
+        if (direction == PICK_AWAITING_VERDICT) {
+            usleep(TIME_BETWEEN_ROGUE_TICKS / 50); // next sample has not happened yet
+            continue;
+        }
+        if (direction == '-') {
+            break; // unlocked
+        }
+
+        // write the next pick right after the sample so the next tick already judges it
+        float pick = pick_search_feedback(&search, direction);
+        dungeon_store_pick(d, pick);
+        dungeon_store_direction(d, PICK_AWAITING_VERDICT);
+        trace_pick(ctx, pick);
+    }
+    stat_record(ctx->stats, METRIC_PICK_TICKS, search.ticks);
+    trace_event(ctx->trace, TRACE_HANDLER_END, TRACE_PICK);
+
+    if (!ctx->quiet) {
+        printf("[%s] Lock picked at %.2f in %u ticks (%u restarts), %.1f ms\n", ctx->name,
+               search.guess, search.ticks, search.restarts,
+               (double)(dungeon_now_ns() - start) / 1e6);
+        fflush(stdout);
+    }
+}
+
+// copy each treasure character into spoils as soon as the dungeon writes it
+void rogue_collect_treasure(struct RoleContext *ctx) {
+    struct Dungeon *d = ctx->dungeon;
+    trace_event(ctx->trace, TRACE_HANDLER_BEGIN, TRACE_TREASURE);
+    if (!ctx->quiet) {
+        printf("[%s] Starting treasure collection...\n", ctx->name);
+        fflush(stdout);
+    }
+
+    char treasure[sizeof(d->treasure)]; // written one character at a time by the dungeon
+    const int slots = (int)sizeof(d->spoils);
+    uint64_t start = dungeon_now_ns();
+    uint64_t deadline = start + (uint64_t)TIME_TREASURE_AVAILABLE * 1000000000ull;
+    unsigned attempts = 0; // passes over treasure[]
+    int found = 0;
+
+    while (dungeon_running(d) && dungeon_now_ns() < deadline) {
+        ++attempts;
+        found = 0;
+        dungeon_read_treasure(d, treasure);
+        for (int i = 0; i < slots; ++i) {
+            char c = treasure[i];
+            if (c == '\0') continue; // not written yet
+            if (dungeon_load_spoil(d, i) != c) {
+                dungeon_store_spoil(d, i, c);
+                trace_event(ctx->trace, TRACE_WRITE_SPOIL, (uint32_t)i << 8 | (unsigned char)c);
+            }
+            ++found;
+        }
+        if (found == slots) {
+            break; // all four are in, no reason to wait for the door
+        }
+        usleep(TIME_BETWEEN_ROGUE_TICKS / 50); // same sampling rate as the lock
+    }
+
+    // hand the door back to the barbarian
+    uint64_t doneNs = dungeon_now_ns();
+    atomic_store_explicit(&d->room.spoilsDoneNs, doneNs, memory_order_release);
+    if (found == slots) stat_record(ctx->stats, METRIC_TREASURE, doneNs - start);
+    sem_t *done = spoils_ready(ctx);
+    if (done && sem_post(done) == -1) {
+        perror("rogue: sem_post spoils ready");
+    }
+    trace_event(ctx->trace, TRACE_SEM_POST, TRACE_SPOILS_READY);
+
+    if (!ctx->quiet) {
+        double ms = (double)(dungeon_now_ns() - start) / 1e6;
+        char got[4];
+        for (int i = 0; i < 4; ++i) {
+            char c = dungeon_load_spoil(d, i);
+            got[i] = c ? c : ' ';
+        }
+        printf("[%s] Treasure %s: %c%c%c%c (%d/%d) in %.1f ms, %u attempts\n", ctx->name,
+               found == slots ? "collected" : "incomplete",
+               got[0], got[1], got[2], got[3], found, slots, ms, attempts);
+        fflush(stdout);
+    }
+    trace_event(ctx->trace, TRACE_HANDLER_END, TRACE_TREASURE);
+}
+
+// ---- queued encounters ----
+
+#define QUEUE_BATCH (16) // commands taken per pass
+
+static void answer_command(struct RoleContext *ctx, const struct QueueCommand *c, struct QueueCompletion *done) {
+    memset(done, 0, sizeof(*done));
+    done->round = c->round;
+    done->type = c->type;
+    done->status = QUEUE_STATUS_UNKNOWN;
+    struct SpellArena *a = ctx->spellArena;
+    if (c->type == QUEUE_ATTACK && ctx->role == ROLE_BARBARIAN) {
+        dungeon_store_attack(ctx->dungeon, c->value); // the field still shows the last attack
+        trace_event(ctx->trace, TRACE_WRITE_ATTACK, (uint32_t)c->value);
+        done->value = c->value;
+        done->status = QUEUE_STATUS_DONE;
+    } else if (c->type == QUEUE_DECODE && ctx->role == ROLE_WIZARD && a && c->ref < a->capacity &&
+               c->length >= 1 && spell_record_size(c->length) <= a->capacity - c->ref) {
+        char *spell = (char *)(spell_arena_record(a, c->ref) + 1);
+        size_t n = c->length - 1; // after the key byte
+        int shift = ((unsigned char)spell[0]) % 26;
+        if (ctx->spellWorkers) {
+            spell_workers_decode(ctx->spellWorkers, spell + 1, n, shift);
+        } else {
+            spell_decode_body(spell + 1, spell + 1, n, shift);
+        }
+        trace_event(ctx->trace, TRACE_WRITE_SPELL, (uint32_t)n);
+        done->ref = (uint64_t)((unsigned char *)spell + 1 - a->records);
+        done->length = (uint32_t)n;
+        done->status = QUEUE_STATUS_DONE;
+    }
+    done->doneNs = dungeon_now_ns();
+}
+
+uint32_t role_drain_queue(struct RoleContext *ctx) {
+    struct RoleQueue *q = dungeon_queue(ctx->queues, ctx->role);
+    if (!q) return 0;
+    struct QueueCommand cmds[QUEUE_BATCH];
+    struct QueueCompletion done[QUEUE_BATCH];
+    uint32_t total = 0;
+    uint32_t n;
+    while ((n = queue_take(q, cmds, QUEUE_BATCH)) > 0) {
+        for (uint32_t i = 0; i < n; ++i) {
+            answer_command(ctx, &cmds[i], &done[i]);
+        }
+        queue_complete(q, done, n); // one release store per batch
+        total += n;
+    }
+    return total;
+}
+
+// ---- dispatch ----
+
+bool role_dispatch(struct RoleContext *ctx, uint32_t bits) {
+    struct Dungeon *d = ctx->dungeon;
+    if ((bits & DOORBELL_SHUTDOWN) || !dungeon_running(d)) {
+        return false;
+    }
+    if (bits & DOORBELL_ENCOUNTER) {
+        switch (ctx->role) {
+        case ROLE_BARBARIAN: barbarian_attack(ctx); break;
+        case ROLE_WIZARD:    wizard_decode_barrier(ctx); break;
+        case ROLE_ROGUE:
+            if (dungeon_trap_locked(d)) rogue_pick_lock(ctx);
+            break;
+        default: break;
+        }
+    }
+    if (bits & DOORBELL_SEMAPHORE) {
+        if (ctx->role == ROLE_BARBARIAN) barbarian_pull_levers(ctx);
+        if (ctx->role == ROLE_ROGUE) rogue_collect_treasure(ctx);
+    }
+    if (bits & DOORBELL_QUEUE) {
+        role_drain_queue(ctx);
+    }
+    return true;
+}
+
+void *role_thread_main(void *arg) {
+    struct RoleContext *ctx = arg;
+    struct Dungeon *d = ctx->dungeon;
+    ctx->bellSeen = atomic_load(&d->doorbell.generation[ctx->role]);
+    dungeon_mark_ready(d, ctx->role);
+
+    for (;;) {
+        uint32_t bits = doorbell_wait(d, ctx->role, &ctx->bellSeen, -1, -1); // futex, no signals
+        if (!role_dispatch(ctx, bits)) break;
+    }
+    role_context_close(ctx);
+    return NULL;
+}
@@ -0,0 +1,76 @@
+#ifndef ROLES_H
+#define ROLES_H
+//Library form of the barbarian, wizard and rogue. Each handler does one role's work for one
+//event against a struct Dungeon, so the same code runs in the per-process binaries (which get
+//their events from dungeon_runtime.h) and as threads in the party binary (party.c).
+#include <stdbool.h>
+#include <stdint.h>
+#include <semaphore.h>
+
+#include "dungeon_info.h"
+#include "dungeon_clock.h"
+#include "dungeon_stats.h"
+#include "dungeon_trace.h"
+#include "spell_cache.h"
+#include "spell_arena.h"
+#include "spell_workers.h"
+
+struct RoleContext{
+	struct Dungeon *dungeon;
+	enum DungeonRole role;
+	const char *name;   //"Barbarian", "Wizard", "Rogue": prefix of the role's output
+	bool quiet;         //no per-event output; the party runs thousands of rounds
+	sem_t *lever1;      //barbarian: the treasure room levers, opened by name when NULL
+	sem_t *lever2;
+	sem_t *spoilsReady; //rogue posts, barbarian waits; opened by name when NULL
+	bool ownsLevers;    //semaphore handles were opened here and are closed by role_context_close()
+	uint32_t bellSeen;  //role_thread_main(): last doorbell generation seen
+	struct LatencyStats leverHold;  //barbarian: levers pulled -> levers posted
+	struct LatencyStats leverRelease; //barbarian: rogue posted /SpoilsReady -> levers posted
+	struct LatencyStats healthToAttack; //barbarian: health published -> attack committed
+	uint32_t healthSeen; //barbarian: last enemy generation answered (dungeon_watch_health())
+	struct RoleStats *stats; //live metrics in the stats extension, NULL for none (the party)
+	struct TraceRing *trace; //event ring in /DungeonTrace, NULL unless tracing
+	struct SpellCache *spellCache; //wizard: decode cache, NULL decodes every spell
+	struct SpellArena *spellArena; //wizard: large spells (spell_arena.h), NULL in the normal game
+	struct SpellWorkers *spellWorkers; //wizard: threads for the large spells
+	struct DungeonQueues *queues; //barbarian and wizard: command queues, NULL for none
+};
+
+void role_context_init(struct RoleContext *ctx, struct Dungeon *d, enum DungeonRole role);
+void role_context_close(struct RoleContext *ctx);
+
+//Barbarian: commit enemy.health to barbarian.attack with one release store, and again for every
+//health published meanwhile, then return at once so the caller goes back to listening.
+void barbarian_attack(struct RoleContext *ctx);
+//Barbarian: hold both levers until the rogue posts /SpoilsReady (at most TIME_TREASURE_AVAILABLE),
+//then release them.
+void barbarian_pull_levers(struct RoleContext *ctx);
+//Wizard: decode barrier.spell into wizard.spell, or the spell pending in the arena in place.
+void wizard_decode_barrier(struct RoleContext *ctx);
+//Wizard: take large spells from arena from now on, decoded with workers (started here).
+void wizard_use_spell_arena(struct RoleContext *ctx, struct SpellArena *arena, struct SpellWorkers *workers);
+//Wizard: print what the workers did and stop them.
+void wizard_spell_arena_close(struct RoleContext *ctx);
+//Wizard: decode through cache from now on, warmed up as DUNGEON_SPELL_WARMUP says: unset for the
+//phrases in spell_phrases.h, 0 to start cold, anything else is a file with one phrase per line.
+void wizard_use_spell_cache(struct RoleContext *ctx, struct SpellCache *cache);
+//Wizard: print the cache's hit/miss counters.
+void wizard_spell_cache_report(const struct RoleContext *ctx);
+//Rogue: move the pick by the dungeon's verdicts until the trap is unlocked.
+void rogue_pick_lock(struct RoleContext *ctx);
+//Rogue: copy the treasure into spoils as it appears, then post /SpoilsReady.
+void rogue_collect_treasure(struct RoleContext *ctx);
+
+//Barbarian and wizard: answer every command in the role's queue (dungeon_queue.h), a batch at a
+//time, until it is empty. Returns the number answered.
+uint32_t role_drain_queue(struct RoleContext *ctx);
+
+//Run the role's handlers for the DOORBELL_* bits of one wakeup.
+//Returns false once the role should stop (DOORBELL_SHUTDOWN or the dungeon no longer running).
+bool role_dispatch(struct RoleContext *ctx, uint32_t bits);
+
+//pthread entry point for a role in the party: marks the role ready, then waits on its
+//doorbell futex and dispatches until shutdown. arg is a struct RoleContext *.
+void *role_thread_main(void *arg);
+#endif
@@ -0,0 +1,160 @@
+#ifndef SPELL_ARENA_H
+#define SPELL_ARENA_H
+//Large-spell mode: barrier spells of any size in the spells extension of /DungeonMem
+//(dungeon_segment.h) instead of the SPELL_BUFFER_SIZE arrays in struct Dungeon. The dungeon writes a spell as a length-prefixed
+//record (key byte, then the encoded text, like barrier.spell) and publishes its offset; the
+//wizard decodes the text in place and publishes where the plaintext is. Nothing is copied, and
+//struct Dungeon keeps its size.
+//Each side owns one cache line of the header and publishes with a release store of its sequence
+//number, so a reader that sees the number with acquire also sees the record it names.
+//The writer bump-allocates records and wraps to the start when one does not fit; a capacity of
+//two records (spell_arena_capacity()) lets a spell be written while the wizard may still be busy
+//with the one before it.
+//Files that include this need _DEFAULT_SOURCE (or _GNU_SOURCE).
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "dungeon_info.h"
+#include "dungeon_segment.h"
+
+#define SPELL_ARENA_MAGIC (0x4c455053u) //"SPEL"
+#define SPELL_ARENA_VERSION (1u)
+#define SPELL_ARENA_ALIGN ((size_t)DUNGEON_CACHE_LINE) //records start on their own cache line
+
+struct SpellRecord{
+	uint64_t length; //bytes after the prefix: key byte + encoded text
+	uint64_t reserved;
+	//char spell[length]; then padding to SPELL_ARENA_ALIGN
+};
+
+struct SpellArena{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t capacity; //record bytes after the header
+	uint64_t next;     //writer only: where the next record goes
+	//dungeon -> wizard
+	alignas(DUNGEON_CACHE_LINE) _Atomic uint64_t spellSeq; //spells published so far
+	_Atomic uint64_t spellOffset;                           //record of spell number spellSeq
+	//wizard -> dungeon
+	alignas(DUNGEON_CACHE_LINE) _Atomic uint64_t answerSeq; //spellSeq that was decoded last
+	_Atomic uint64_t answerOffset;                           //plaintext, from the arena start
+	_Atomic uint64_t answerLength;
+	alignas(DUNGEON_CACHE_LINE) unsigned char records[];
+};
+
+static inline size_t spell_record_size(size_t length){
+	size_t n = sizeof(struct SpellRecord) + length;
+	return (n + SPELL_ARENA_ALIGN - 1) & ~(SPELL_ARENA_ALIGN - 1);
+}
+
+//Record capacity for spells of up to spellBytes (key byte included), two at a time.
+static inline size_t spell_arena_capacity(size_t spellBytes){
+	return 2 * spell_record_size(spellBytes);
+}
+
+static inline size_t spell_arena_bytes(size_t capacity){
+	return sizeof(struct SpellArena) + capacity;
+}
+
+//Stamp the header of a fresh (zeroed) arena, so only the header needs setting.
+static inline struct SpellArena *spell_arena_init(void *mem, size_t capacity){
+	struct SpellArena *a = mem;
+	if (!a) return NULL;
+	a->magic = SPELL_ARENA_MAGIC;
+	a->version = SPELL_ARENA_VERSION;
+	a->capacity = capacity;
+	return a;
+}
+
+//Launcher: the arena in the spells extension, which create_shared_dungeon() was asked to lay
+//out with spell_arena_bytes(capacity). NULL on failure.
+static inline struct SpellArena *spell_arena_create(size_t capacity){
+	return spell_arena_init(dungeon_extension_open(DUNGEON_EXT_SPELLS, spell_arena_bytes(capacity), true), capacity);
+}
+
+//An anonymous arena for threads of one process (the party). NULL on failure.
+static inline struct SpellArena *spell_arena_create_private(size_t capacity){
+	void *mem = mmap(NULL, spell_arena_bytes(capacity), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	return spell_arena_init(mem == MAP_FAILED ? NULL : mem, capacity);
+}
+
+//Wizard: map the launcher's arena. NULL without one, the normal (small spell) case.
+static inline struct SpellArena *spell_arena_open(void){
+	size_t length = dungeon_extension_length(DUNGEON_EXT_SPELLS);
+	if (length < sizeof(struct SpellArena)) return NULL;
+	struct SpellArena *a = dungeon_extension_open(DUNGEON_EXT_SPELLS, length, true);
+	if (!a) return NULL;
+	if (a->magic != SPELL_ARENA_MAGIC || a->version != SPELL_ARENA_VERSION || spell_arena_bytes(a->capacity) > length) {
+		dungeon_extension_close(a, length);
+		return NULL;
+	}
+	return a;
+}
+
+static inline void spell_arena_close(struct SpellArena *a){
+	if (a) munmap(a, spell_arena_bytes(a->capacity));
+}
+
+static inline struct SpellRecord *spell_arena_record(struct SpellArena *a, uint64_t offset){
+	return (struct SpellRecord *)(a->records + offset);
+}
+
+//Dungeon: room for a spell of length bytes; fill in the returned buffer, then publish offset.
+//NULL if the spell can never fit.
+static inline char *spell_arena_reserve(struct SpellArena *a, size_t length, uint64_t *offset){
+	size_t n = spell_record_size(length);
+	if (n > a->capacity) return NULL;
+	if (a->next + n > a->capacity) a->next = 0;
+	*offset = a->next;
+	a->next += n;
+	struct SpellRecord *r = spell_arena_record(a, *offset);
+	r->length = length;
+	return (char *)(r + 1);
+}
+
+//Dungeon: make the record at offset the current spell. Returns its sequence number.
+static inline uint64_t spell_arena_publish(struct SpellArena *a, uint64_t offset){
+	uint64_t seq = atomic_load_explicit(&a->spellSeq, memory_order_relaxed) + 1;
+	atomic_store_explicit(&a->spellOffset, offset, memory_order_relaxed);
+	atomic_store_explicit(&a->spellSeq, seq, memory_order_release); //record and offset land first
+	return seq;
+}
+
+//Wizard: the spell published since the last answer, or NULL if there is none. A spell the
+//dungeon overwrites mid-decode (it gave up on the wizard twice over) decodes to garbage that
+//the dungeon's check rejects.
+static inline struct SpellRecord *spell_arena_pending(struct SpellArena *a, uint64_t *seq){
+	if (!a) return NULL;
+	*seq = atomic_load_explicit(&a->spellSeq, memory_order_acquire);
+	if (*seq == atomic_load_explicit(&a->answerSeq, memory_order_relaxed)) return NULL;
+	uint64_t offset = atomic_load_explicit(&a->spellOffset, memory_order_relaxed);
+	if (offset >= a->capacity) return NULL;
+	struct SpellRecord *r = spell_arena_record(a, offset);
+	if (r->length > a->capacity - offset - sizeof(*r)) return NULL;
+	return r;
+}
+
+//Wizard: plaintext of spell seq is length bytes at data.
+static inline void spell_arena_answer(struct SpellArena *a, uint64_t seq, const char *data, size_t length){
+	atomic_store_explicit(&a->answerOffset, (uint64_t)((const unsigned char *)data - a->records),
+	                      memory_order_relaxed);
+	atomic_store_explicit(&a->answerLength, length, memory_order_relaxed);
+	atomic_store_explicit(&a->answerSeq, seq, memory_order_release);
+}
+
+//Dungeon: the plaintext for spell seq once the wizard has published it, else NULL.
+static inline const char *spell_arena_answered(struct SpellArena *a, uint64_t seq, size_t *length){
+	if (atomic_load_explicit(&a->answerSeq, memory_order_acquire) != seq) return NULL;
+	uint64_t offset = atomic_load_explicit(&a->answerOffset, memory_order_relaxed);
+	*length = atomic_load_explicit(&a->answerLength, memory_order_relaxed);
+	if (offset > a->capacity || *length > a->capacity - offset) return NULL;
+	return (const char *)a->records + offset;
+}
+#endif
@@ -0,0 +1,149 @@
+// spell_cache.c
+// Decode cache for the wizard: (shift, encoded body) -> plaintext, in a fixed-size table.
+#define _DEFAULT_SOURCE // strnlen()
+
+#include <stdio.h> // fopen()
+#include <string.h> // memcmp(), memcpy()
+
+#include "spell_cache.h"
+#include "spell_decode.h"
+
+#define SPELL_CACHE_SETS (SPELL_CACHE_SLOTS / SPELL_CACHE_WAYS)
+
+void spell_cache_init(struct SpellCache *c) {
+    memset(c, 0, sizeof(*c));
+}
+
+// 8 bytes per step, so hashing a spell costs a fraction of decoding it
+static uint64_t spell_hash(const char *body, size_t n, int shift) {
+    uint64_t h = 0x9e3779b97f4a7c15ull ^ ((uint64_t)n << 8) ^ (uint64_t)shift;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t w;
+        memcpy(&w, body + i, sizeof(w));
+        h = (h ^ w) * 0xff51afd7ed558ccdull;
+        h ^= h >> 32;
+    }
+    uint64_t w = 0;
+    memcpy(&w, body + i, n - i);
+    h ^= w;
+    h ^= h >> 33; // murmur3 finalizer: every input bit reaches the set index bits
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+static struct SpellCacheEntry *spell_cache_find(struct SpellCache *c, uint64_t h, int shift,
+                                                const char *body, size_t n) {
+    struct SpellCacheEntry *set = &c->slots[(h % SPELL_CACHE_SETS) * SPELL_CACHE_WAYS];
+    for (int w = 0; w < SPELL_CACHE_WAYS; ++w) {
+        struct SpellCacheEntry *e = &set[w];
+        if (e->used && e->hash == h && e->shift == shift && e->len == n && memcmp(e->body, body, n) == 0) {
+            return e; // the text is compared too, so a hash collision is only a miss
+        }
+    }
+    return NULL;
+}
+
+static void spell_cache_insert(struct SpellCache *c, uint64_t h, int shift, const char *body,
+                               const char *plain, size_t n) {
+    size_t set = h % SPELL_CACHE_SETS;
+    struct SpellCacheEntry *ways = &c->slots[set * SPELL_CACHE_WAYS];
+    struct SpellCacheEntry *e = NULL;
+    for (int w = 0; w < SPELL_CACHE_WAYS && !e; ++w) {
+        if (!ways[w].used) e = &ways[w];
+    }
+    if (!e) { // set is full: replace in turn
+        e = &ways[c->next[set]];
+        c->next[set] = (uint8_t)((c->next[set] + 1) % SPELL_CACHE_WAYS);
+        c->evictions++;
+    } else {
+        c->entries++;
+    }
+    e->hash = h;
+    e->used = true;
+    e->shift = (uint8_t)shift;
+    e->len = (uint8_t)n;
+    memcpy(e->body, body, n);
+    memcpy(e->plain, plain, n);
+    e->plain[n] = '\0';
+}
+
+size_t spell_cache_decode(struct SpellCache *c, char *out, size_t outSize, const char *encoded,
+                          size_t encodedSize) {
+    if (!out || outSize == 0 || !encoded || encodedSize == 0 || encoded[0] == '\0') {
+        return spell_decode(out, outSize, encoded, encodedSize);
+    }
+    int shift = ((unsigned char)encoded[0]) % 26;
+
+    // the body spell_decode() would decode: same limits
+    size_t limit = encodedSize - 1;
+    if (limit > outSize - 1) limit = outSize - 1;
+    size_t n = strnlen(encoded + 1, limit);
+    // too long to keep: decode the body already measured above. n <= limit, so only a buffer
+    // bigger than an entry can get here; saying so drops the branch for the callers that pass
+    // SPELL_BUFFER_SIZE, where the compiler would otherwise see out[n] past their end.
+    if (limit >= SPELL_CACHE_TEXT && n >= SPELL_CACHE_TEXT) {
+        spell_decode_body(out, encoded + 1, n, shift);
+        out[n] = '\0';
+        return n;
+    }
+
+    uint64_t h = spell_hash(encoded + 1, n, shift);
+    struct SpellCacheEntry *e = spell_cache_find(c, h, shift, encoded + 1, n);
+    if (e) {
+        c->hits++;
+        memcpy(out, e->plain, n + 1);
+        return n;
+    }
+    c->misses++;
+    spell_decode_body(out, encoded + 1, n, shift);
+    out[n] = '\0';
+    spell_cache_insert(c, h, shift, encoded + 1, out, n);
+    return n;
+}
+
+// Enter one plaintext under every shift, encoded the way the dungeon does it
+static void spell_cache_warm_one(struct SpellCache *c, const char *phrase) {
+    size_t n = strnlen(phrase, SPELL_CACHE_TEXT - 1);
+    char body[SPELL_CACHE_TEXT];
+    for (int shift = 0; shift < 26; ++shift) {
+        for (size_t i = 0; i < n; ++i) {
+            char ch = phrase[i];
+            if (ch >= 'A' && ch <= 'Z') ch = (char)('A' + (ch - 'A' + shift) % 26);
+            else if (ch >= 'a' && ch <= 'z') ch = (char)('a' + (ch - 'a' + shift) % 26);
+            body[i] = ch;
+        }
+        uint64_t h = spell_hash(body, n, shift);
+        if (!spell_cache_find(c, h, shift, body, n)) {
+            spell_cache_insert(c, h, shift, body, phrase, n);
+        }
+    }
+}
+
+size_t spell_cache_warm(struct SpellCache *c, const char *const *phrases, size_t n) {
+    size_t entered = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (!phrases[i] || !phrases[i][0]) continue;
+        spell_cache_warm_one(c, phrases[i]);
+        ++entered;
+    }
+    return entered;
+}
+
+long spell_cache_warm_file(struct SpellCache *c, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    long entered = 0;
+    char line[4 * SPELL_CACHE_TEXT];
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0') continue;
+        spell_cache_warm_one(c, line);
+        ++entered;
+    }
+    fclose(f);
+    return entered;
+}
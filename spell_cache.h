@@ -0,0 +1,49 @@
+#ifndef SPELL_CACHE_H
+#define SPELL_CACHE_H
+//Memoizing front end for spell_decode(). The barrier phrases come from a small pool, so the
+//same (shift mod 26, encoded text) pair keeps coming back; a hit answers with one copy of the
+//plaintext decoded the first time. The cache is a fixed array, 8-way (SPELL_CACHE_WAYS) set
+//associative with round-robin replacement, so its memory is bounded by SPELL_CACHE_SLOTS. One
+//cache per wizard: it is not thread safe.
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dungeon_settings.h"
+
+#ifndef SPELL_CACHE_SLOTS
+#define SPELL_CACHE_SLOTS (512) //power of two, a multiple of SPELL_CACHE_WAYS; about 100 KB
+#endif
+#define SPELL_CACHE_WAYS (8)
+#define SPELL_CACHE_TEXT (SPELL_BUFFER_SIZE) //longest body spell_decode() produces, plus the NUL
+
+struct SpellCacheEntry{
+	uint64_t hash;
+	bool used;
+	uint8_t shift;                 //key, mod 26
+	uint8_t len;                   //key: body length
+	char body[SPELL_CACHE_TEXT];   //key: encoded text without the shift byte
+	char plain[SPELL_CACHE_TEXT];  //decoded text, NUL terminated
+};
+
+struct SpellCache{
+	struct SpellCacheEntry slots[SPELL_CACHE_SLOTS];
+	uint8_t next[SPELL_CACHE_SLOTS / SPELL_CACHE_WAYS]; //round-robin victim per set
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	uint32_t entries;
+};
+
+void spell_cache_init(struct SpellCache *c);
+
+//Same contract as spell_decode(), answered from the cache when possible.
+size_t spell_cache_decode(struct SpellCache *c, char *out, size_t outSize, const char *encoded,
+                          size_t encodedSize);
+
+//Warm-up: enter each phrase under all 26 shifts, so even the first encounter is a hit.
+//Returns the number of phrases entered.
+size_t spell_cache_warm(struct SpellCache *c, const char *const *phrases, size_t n);
+//Same with one phrase per line from a file. Returns the number entered, or -1 if it can't be read.
+long spell_cache_warm_file(struct SpellCache *c, const char *path);
+#endif
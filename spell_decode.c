@@ -0,0 +1,152 @@
+// spell_decode.c
+// Caesar decoder for the wizard: scalar reference plus SSE2/AVX2 kernels chosen at runtime.
+#define _DEFAULT_SOURCE // strnlen()
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SPELL_HAVE_X86 1
+#endif
+
+#include "spell_decode.h"
+
+void spell_decode_scalar(char *out, const char *in, size_t n, int shift) {
+    for (size_t i = 0; i < n; ++i) {
+        char c = in[i]; // character to decode
+
+        if (c >= 'A' && c <= 'Z') {  // uppercase letter decoding
+            int idx = c - 'A';
+            idx = (idx - shift) % 26;
+            if (idx < 0) idx += 26;
+            out[i] = (char)('A' + idx);
+        } else if (c >= 'a' && c <= 'z') { // lowercase letter decoding
+            int idx = c - 'a';
+            idx = (idx - shift) % 26;
+            if (idx < 0) idx += 26;
+            out[i] = (char)('a' + idx);
+        } else {
+            out[i] = c;
+        }
+    }
+}
+
+#ifdef SPELL_HAVE_X86
+// Branch-free version of the scalar loop, 16 bytes at a time. Letters are all below 0x80, so
+// signed byte compares work: bytes >= 0x80 are negative and never look like letters.
+// After subtracting the shift (0..25) a letter that fell below 'A'/'a' gets 26 added back.
+__attribute__((target("sse2")))
+void spell_decode_sse2(char *out, const char *in, size_t n, int shift) {
+    const __m128i upper_lo = _mm_set1_epi8('A' - 1);
+    const __m128i upper_hi = _mm_set1_epi8('Z' + 1);
+    const __m128i lower_lo = _mm_set1_epi8('a' - 1);
+    const __m128i lower_hi = _mm_set1_epi8('z' + 1);
+    const __m128i upper_a  = _mm_set1_epi8('A');
+    const __m128i lower_a  = _mm_set1_epi8('a');
+    const __m128i wrap     = _mm_set1_epi8(26);
+    const __m128i key      = _mm_set1_epi8((char)shift);
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i c = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i is_upper = _mm_and_si128(_mm_cmpgt_epi8(c, upper_lo), _mm_cmpgt_epi8(upper_hi, c));
+        __m128i is_lower = _mm_and_si128(_mm_cmpgt_epi8(c, lower_lo), _mm_cmpgt_epi8(lower_hi, c));
+        __m128i shifted  = _mm_sub_epi8(c, key);
+        __m128i wrapped  = _mm_or_si128(_mm_and_si128(is_upper, _mm_cmpgt_epi8(upper_a, shifted)),
+                                        _mm_and_si128(is_lower, _mm_cmpgt_epi8(lower_a, shifted)));
+        __m128i decoded  = _mm_add_epi8(shifted, _mm_and_si128(wrapped, wrap));
+        __m128i letter   = _mm_or_si128(is_upper, is_lower);
+        __m128i result   = _mm_or_si128(_mm_and_si128(letter, decoded), _mm_andnot_si128(letter, c));
+        _mm_storeu_si128((__m128i *)(out + i), result);
+    }
+    spell_decode_scalar(out + i, in + i, n - i, shift); // tail
+}
+
+// Same as the SSE2 kernel with 32 bytes per step.
+__attribute__((target("avx2")))
+void spell_decode_avx2(char *out, const char *in, size_t n, int shift) {
+    const __m256i upper_lo = _mm256_set1_epi8('A' - 1);
+    const __m256i upper_hi = _mm256_set1_epi8('Z' + 1);
+    const __m256i lower_lo = _mm256_set1_epi8('a' - 1);
+    const __m256i lower_hi = _mm256_set1_epi8('z' + 1);
+    const __m256i upper_a  = _mm256_set1_epi8('A');
+    const __m256i lower_a  = _mm256_set1_epi8('a');
+    const __m256i wrap     = _mm256_set1_epi8(26);
+    const __m256i key      = _mm256_set1_epi8((char)shift);
+
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i c = _mm256_loadu_si256((const __m256i *)(in + i));
+        __m256i is_upper = _mm256_and_si256(_mm256_cmpgt_epi8(c, upper_lo), _mm256_cmpgt_epi8(upper_hi, c));
+        __m256i is_lower = _mm256_and_si256(_mm256_cmpgt_epi8(c, lower_lo), _mm256_cmpgt_epi8(lower_hi, c));
+        __m256i shifted  = _mm256_sub_epi8(c, key);
+        __m256i wrapped  = _mm256_or_si256(_mm256_and_si256(is_upper, _mm256_cmpgt_epi8(upper_a, shifted)),
+                                           _mm256_and_si256(is_lower, _mm256_cmpgt_epi8(lower_a, shifted)));
+        __m256i decoded  = _mm256_add_epi8(shifted, _mm256_and_si256(wrapped, wrap));
+        __m256i letter   = _mm256_or_si256(is_upper, is_lower);
+        __m256i result   = _mm256_blendv_epi8(c, decoded, letter);
+        _mm256_storeu_si256((__m256i *)(out + i), result);
+    }
+    // the SSE2 kernel is legacy-encoded: clear the upper halves first, or every SSE instruction
+    // in it pays the AVX-to-SSE transition
+    _mm256_zeroupper();
+    spell_decode_sse2(out + i, in + i, n - i, shift); // tail
+}
+#else
+// No x86 SIMD on this architecture: both kernels fall back to the scalar loop.
+void spell_decode_sse2(char *out, const char *in, size_t n, int shift) {
+    spell_decode_scalar(out, in, n, shift);
+}
+void spell_decode_avx2(char *out, const char *in, size_t n, int shift) {
+    spell_decode_scalar(out, in, n, shift);
+}
+#endif
+
+typedef void (*spell_kernel_fn)(char *, const char *, size_t, int);
+
+static spell_kernel_fn g_kernel = NULL;
+static const char *g_kernel_name = "scalar";
+
+static void pick_kernel(void) {
+    g_kernel = spell_decode_scalar;
+    g_kernel_name = "scalar";
+#ifdef SPELL_HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        g_kernel = spell_decode_avx2;
+        g_kernel_name = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        g_kernel = spell_decode_sse2;
+        g_kernel_name = "sse2";
+    }
+#endif
+}
+
+void spell_decode_body(char *out, const char *in, size_t n, int shift) {
+    if (!g_kernel) pick_kernel();
+    g_kernel(out, in, n, shift);
+}
+
+const char *spell_decode_kernel_name(void) {
+    if (!g_kernel) pick_kernel();
+    return g_kernel_name;
+}
+
+size_t spell_decode(char *out, size_t outSize, const char *encoded, size_t encodedSize) {
+    if (!out || outSize == 0) return 0;
+    if (!encoded || encodedSize == 0 || encoded[0] == '\0') {
+        out[0] = '\0';
+        return 0;
+    }
+
+    int shift = ((unsigned char)encoded[0]) % 26;
+
+    // same limits as the original loop: stop at the NUL, the end of the input, or outSize - 1
+    size_t limit = encodedSize - 1;
+    if (limit > outSize - 1) limit = outSize - 1;
+    size_t n = strnlen(encoded + 1, limit);
+
+    spell_decode_body(out, encoded + 1, n, shift);
+    out[n] = '\0'; // null terminate the decode
+    return n;
+}
@@ -0,0 +1,21 @@
+#ifndef SPELL_DECODE_H
+#define SPELL_DECODE_H
+//Caesar decoding of the barrier spells. The first byte of an encoded spell is the shift key
+//(taken mod 26); letters are shifted back and keep their case, everything else is copied.
+#include <stddef.h>
+
+//Decode n bytes of spell text (without the shift byte) from in to out. out may equal in.
+//The _sse2 and _avx2 kernels give byte-for-byte the same output as the scalar one.
+void spell_decode_scalar(char *out, const char *in, size_t n, int shift);
+void spell_decode_sse2(char *out, const char *in, size_t n, int shift);
+void spell_decode_avx2(char *out, const char *in, size_t n, int shift);
+
+//Best kernel for this CPU, picked once at runtime (AVX2, then SSE2, then scalar).
+void spell_decode_body(char *out, const char *in, size_t n, int shift);
+const char *spell_decode_kernel_name(void);
+
+//Decode a whole barrier spell (shift byte + NUL terminated text, at most encodedSize bytes)
+//into out, which holds outSize bytes including the NUL. Longer spells are truncated the same
+//way the original wizard did it. Returns the decoded length.
+size_t spell_decode(char *out, size_t outSize, const char *encoded, size_t encodedSize);
+#endif
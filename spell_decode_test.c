@@ -0,0 +1,123 @@
+// spell_decode_test.c
+// Differential test of the wizard's decoders: the SSE2, AVX2 and dispatched kernels, and
+// spell_decode() on whole spells, must give byte for byte what the scalar kernel gives.
+// Random text (every byte value) under every key 0..255, every length 0..SPELL_BUFFER_SIZE and
+// some past the 16/32-byte steps, from unaligned buffers, out of place and in place.
+//   make test
+#define _DEFAULT_SOURCE // strnlen()
+
+#include <stdio.h> // printf()
+#include <stdlib.h> // rand_r()
+#include <string.h> // memcmp()
+
+#include "dungeon_settings.h" // SPELL_BUFFER_SIZE
+#include "spell_decode.h"
+
+#define MAX_LEN (SPELL_BUFFER_SIZE + 64)
+#define MAX_SKEW (4)  // start offsets 0..MAX_SKEW-1, so loads and stores are unaligned
+#define GUARD (32)    // bytes after the output that no kernel may touch
+#define GUARD_BYTE ((char)0xa5)
+
+typedef void (*kernel_fn)(char *, const char *, size_t, int);
+
+static int g_failures = 0;
+
+static void fail(const char *kernel, const char *how, int key, size_t n, size_t skew) {
+    if (++g_failures <= 20) {
+        fprintf(stderr, "FAIL %s %s: key=%d len=%zu offset=%zu\n", kernel, how, key, n, skew);
+    }
+}
+
+// One kernel against the scalar output, out of place and in place
+static void check_kernel(const char *name, kernel_fn kernel, const char *in, const char *want,
+                         int key, size_t n, size_t skew) {
+    int shift = key % 26;
+    char buf[MAX_SKEW + MAX_LEN + GUARD];
+    char *out = buf + skew;
+
+    memset(buf, GUARD_BYTE, sizeof(buf));
+    kernel(out, in, n, shift);
+    if (memcmp(out, want, n) != 0) fail(name, "out of place", key, n, skew);
+    for (size_t i = 0; i < GUARD; ++i) {
+        if (out[n + i] != GUARD_BYTE) {
+            fail(name, "wrote past the end", key, n, skew);
+            break;
+        }
+    }
+
+    memcpy(out, in, n);
+    kernel(out, out, n, shift);
+    if (memcmp(out, want, n) != 0) fail(name, "in place", key, n, skew);
+}
+
+// spell_decode() on the whole spell (key byte + NUL terminated text) against the scalar kernel
+static void check_spell(const char *text, int key, size_t n) {
+    char encoded[MAX_LEN + 2];
+    char want[MAX_LEN + 1];
+    char got[SPELL_BUFFER_SIZE + 1];
+    encoded[0] = (char)key;
+    memcpy(encoded + 1, text, n);
+    encoded[n + 1] = '\0';
+
+    size_t expect = key == 0 ? 0 : strnlen(encoded + 1, SPELL_BUFFER_SIZE); // key 0 reads as an empty spell
+    spell_decode_scalar(want, encoded + 1, expect, key % 26);
+    want[expect] = '\0';
+    size_t len = spell_decode(got, sizeof(got), encoded, sizeof(encoded));
+    if (len != expect || memcmp(got, want, expect + 1) != 0) fail("spell_decode", "whole spell", key, n, 0);
+}
+
+int main(void) {
+    unsigned seed = 326;
+    const struct {
+        const char *name;
+        kernel_fn fn;
+        int avx2;
+    } kernels[] = {
+        { "sse2", spell_decode_sse2, 0 },
+        { "avx2", spell_decode_avx2, 1 },
+        { "dispatch", spell_decode_body, 0 },
+    };
+    int haveAvx2 = 1;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    haveAvx2 = __builtin_cpu_supports("avx2");
+#endif
+
+    char text[MAX_SKEW + MAX_LEN];
+    char want[MAX_LEN];
+    size_t checks = 0;
+    for (int key = 0; key < 256; ++key) {
+        for (size_t i = 0; i < sizeof(text); ++i) {
+            text[i] = (char)(rand_r(&seed) & 0xff); // every byte value, letters or not
+        }
+        for (size_t n = 0; n <= MAX_LEN; ++n) {
+            // every length up to a whole spell, and past it only around the 16/32-byte steps
+            if (n > SPELL_BUFFER_SIZE && n % 16 != 0 && n % 16 != 1 && n % 16 != 15) continue;
+            for (size_t skew = 0; skew < MAX_SKEW; ++skew) {
+                const char *in = text + skew;
+                spell_decode_scalar(want, in, n, key % 26);
+                for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+                    if (kernels[k].avx2 && !haveAvx2) continue;
+                    check_kernel(kernels[k].name, kernels[k].fn, in, want, key, n, skew);
+                    ++checks;
+                }
+            }
+        }
+
+        // whole spells: NUL-free text so the length is the one asked for, then a NUL inside
+        char spell[MAX_LEN];
+        for (size_t i = 0; i < sizeof(spell); ++i) {
+            spell[i] = (char)(1 + rand_r(&seed) % 255);
+        }
+        for (size_t n = 0; n <= SPELL_BUFFER_SIZE; ++n) {
+            check_spell(spell, key, n);
+            ++checks;
+        }
+        spell[17] = '\0';
+        check_spell(spell, key, SPELL_BUFFER_SIZE);
+    }
+
+    printf("spell_decode_test: %zu checks, dispatch kernel %s%s, %d failures\n", checks, spell_decode_kernel_name(),
+           haveAvx2 ? "" : " (no AVX2: avx2 kernel skipped)", g_failures);
+    return g_failures ? 1 : 0;
+}
@@ -0,0 +1,19 @@
+#ifndef SPELL_PHRASES_H
+#define SPELL_PHRASES_H
+//Phrases the prebuilt dungeon uses for its barriers. The local dungeon plays them and the
+//wizard's spell cache (spell_cache.h) is warmed up with them.
+#include <stddef.h>
+
+static const char *const spell_phrases[] = {
+	"Open sesame!",
+	"Speak friend and enter.",
+	"Boggle",
+	"Mother may I enter?",
+	"Simon says, open!",
+	"If you don't open this door right now, I swear...",
+	"Pizza's here!",
+	"Telegram!",
+	"I say unto thee... KNOCK!",
+};
+#define SPELL_NUM_PHRASES (sizeof(spell_phrases) / sizeof(spell_phrases[0]))
+#endif
@@ -0,0 +1,117 @@
+// spell_workers.c
+// Worker threads that decode slices of one large spell in place.
+#define _DEFAULT_SOURCE // sysconf()
+
+#include <stdlib.h> // getenv(), atoi()
+#include <string.h> // memset()
+#include <unistd.h> // sysconf()
+
+#include "spell_workers.h"
+#include "spell_decode.h"
+#include "dungeon_info.h" // DUNGEON_CACHE_LINE
+
+// Slice i of the current job: cache-line-aligned bounds, the last slice runs to the end
+static void slice(const struct SpellWorkers *w, int i, size_t *from, size_t *len) {
+    size_t per = (w->n + (size_t)w->slices - 1) / (size_t)w->slices;
+    per = (per + DUNGEON_CACHE_LINE - 1) & ~(size_t)(DUNGEON_CACHE_LINE - 1);
+    size_t start = per * (size_t)i;
+    size_t end = i == w->slices - 1 || start + per > w->n ? w->n : start + per;
+    *from = start < w->n ? start : w->n;
+    *len = end - *from;
+}
+
+static void *worker_main(void *arg) {
+    struct SpellWorker *a = arg;
+    struct SpellWorkers *w = a->pool;
+    uint64_t seen = 0;
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (!w->stop && w->job == seen) {
+            pthread_cond_wait(&w->start, &w->lock);
+        }
+        if (w->stop) break;
+        seen = w->job;
+        bool mine = a->index < w->slices;
+        size_t from = 0;
+        size_t len = 0;
+        if (mine) slice(w, a->index, &from, &len);
+        pthread_mutex_unlock(&w->lock);
+
+        if (len) spell_decode_body(w->text + from, w->text + from, len, w->shift);
+
+        pthread_mutex_lock(&w->lock);
+        if (mine && --w->pending == 0) pthread_cond_signal(&w->done);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+int spell_workers_init(struct SpellWorkers *w, int workers) {
+    memset(w, 0, sizeof(*w));
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->start, NULL);
+    pthread_cond_init(&w->done, NULL);
+    spell_decode_kernel_name(); // pick the kernel before any thread can race to do it
+
+    if (workers < 0) {
+        const char *env = getenv(SPELL_WORKERS_ENV);
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = env && *env ? atoi(env) : (int)(cpus > 1 ? cpus - 1 : 0);
+    }
+    if (workers > SPELL_MAX_WORKERS) workers = SPELL_MAX_WORKERS;
+    for (int i = 0; i < workers; ++i) {
+        struct SpellWorker *a = &w->workers[i];
+        a->pool = w;
+        a->index = i + 1;
+        if (pthread_create(&a->thread, NULL, worker_main, a) != 0) break;
+        w->count++;
+    }
+    return w->count;
+}
+
+void spell_workers_destroy(struct SpellWorkers *w) {
+    pthread_mutex_lock(&w->lock);
+    w->stop = true;
+    pthread_cond_broadcast(&w->start);
+    pthread_mutex_unlock(&w->lock);
+    for (int i = 0; i < w->count; ++i) {
+        pthread_join(w->workers[i].thread, NULL);
+    }
+    w->count = 0;
+    pthread_cond_destroy(&w->done);
+    pthread_cond_destroy(&w->start);
+    pthread_mutex_destroy(&w->lock);
+}
+
+void spell_workers_decode(struct SpellWorkers *w, char *text, size_t n, int shift) {
+    // one slice per thread, but no slice under SPELL_PARALLEL_MIN / 2
+    size_t slices = n / (SPELL_PARALLEL_MIN / 2);
+    if (slices > (size_t)w->count + 1) slices = (size_t)w->count + 1;
+    if (n < SPELL_PARALLEL_MIN || slices < 2) {
+        spell_decode_body(text, text, n, shift);
+        w->serialJobs++;
+        return;
+    }
+
+    pthread_mutex_lock(&w->lock);
+    w->text = text;
+    w->n = n;
+    w->shift = shift;
+    w->slices = (int)slices;
+    w->pending = (int)slices - 1;
+    w->job++;
+    size_t from;
+    size_t len;
+    slice(w, 0, &from, &len);
+    pthread_cond_broadcast(&w->start);
+    pthread_mutex_unlock(&w->lock);
+
+    spell_decode_body(text + from, text + from, len, shift); // the caller's share
+
+    pthread_mutex_lock(&w->lock);
+    while (w->pending > 0) {
+        pthread_cond_wait(&w->done, &w->lock);
+    }
+    pthread_mutex_unlock(&w->lock);
+    w->parallelJobs++;
+}
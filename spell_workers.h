@@ -0,0 +1,51 @@
+#ifndef SPELL_WORKERS_H
+#define SPELL_WORKERS_H
+//Parallel front end for spell_decode_body(), for the large spells of spell_arena.h. A spell of at
+//least SPELL_PARALLEL_MIN bytes is cut into cache-line-aligned slices, one per thread: the caller
+//decodes the first and each worker one of the others, all in place, so the cost per byte stays
+//that of the SIMD kernel while the threads have cores to run on. Smaller spells, and pools
+//without workers, decode on the calling thread. One pool per wizard: it is not thread safe.
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef SPELL_PARALLEL_MIN
+#define SPELL_PARALLEL_MIN ((size_t)256 << 10) //below this, waking the workers costs more than it saves
+#endif
+#define SPELL_MAX_WORKERS (15) //threads besides the caller
+#define SPELL_WORKERS_ENV "DUNGEON_SPELL_WORKERS" //worker count; default: one per extra CPU
+
+struct SpellWorkers;
+
+struct SpellWorker{
+	struct SpellWorkers *pool;
+	int index;                  //slice number, 1..count
+	pthread_t thread;
+};
+
+struct SpellWorkers{
+	int count;                  //started workers
+	struct SpellWorker workers[SPELL_MAX_WORKERS];
+	pthread_mutex_t lock;
+	pthread_cond_t start;       //a job was posted (or stop)
+	pthread_cond_t done;        //the last slice finished
+	uint64_t job;               //jobs posted so far
+	int pending;                //worker slices not finished yet
+	bool stop;
+	char *text;                 //the job: decode n bytes at text in place
+	size_t n;
+	int shift;
+	int slices;                 //threads on this job, the caller included
+	uint64_t parallelJobs;      //spells split across threads
+	uint64_t serialJobs;        //spells decoded on the calling thread
+};
+
+//Start workers threads (-1: SPELL_WORKERS_ENV, else one per online CPU after the first).
+//Returns the number started; the pool works with none.
+int spell_workers_init(struct SpellWorkers *w, int workers);
+void spell_workers_destroy(struct SpellWorkers *w);
+
+//Decode n bytes of spell text in place with the given shift (already mod 26).
+void spell_workers_decode(struct SpellWorkers *w, char *text, size_t n, int shift);
+#endif
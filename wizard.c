@@ -1,5 +1,5 @@
-// barbarian.c 
-// barbarian copies the enemy health and pulls the treasure levers using semaphores 
+// wizard.c 
+// wizard decodes the barrier spell when signaled; the decode lives in roles.c (wizard_decode_barrier()) 
 #define _DEFAULT_SOURCE  // enables POSIX extention
 
 #include <stdio.h> // standard IO functions
@@ -13,94 +13,67 @@
 
 #include "dungeon_info.h" // contains structs and memory names 
 #include "dungeon_settings.h" // contains config. + constraints
-
-#ifndef WIZARD_SIGNAL // default wizard signal
-#define WIZARD_SIGNAL SIGUSR1
-#endif
+#include "dungeon_runtime.h" // signalfd/epoll event loop 
+#include "dungeon_atomic.h" // dungeon_running() 
+#include "dungeon_attach.h" // dungeon_attach(), dungeon_mark_ready() 
+#include "roles.h" // wizard_decode_barrier(), shared with the party 
+#include "dungeon_queue.h" // the queues extension, mapped on first use 
 
 static struct Dungeon *g_dungeon = NULL;
 
-static void decode_barrier(void) {
-    if (!g_dungeon) return; // abort if not initialized 
-
-    char *encoded = g_dungeon->barrier.spell; // pointer to encoded spell text 
-    char *out     = g_dungeon->wizard.spell; // output buffer for decoded spell 
-
-    if (!encoded || !out) return; // ensure pointer exist 
-
-    if (encoded[0] == '\0') {
-        out[0] = '\0';
-        return;
-    }
-
-    int shift = ((unsigned char)encoded[0]) % 26; 
-
-    size_t in_i;
-    size_t out_i = 0;
-
-   for (in_i = 1; encoded[in_i] != '\0' && out_i < SPELL_BUFFER_SIZE - 1; ++in_i, ++out_i) {
-        char c = encoded[in_i]; // character to decode 
-
-        if (c >= 'A' && c <= 'Z') {  // uppercase letter decoding 
-            int idx = c - 'A';
-            idx = (idx - shift) % 26;
-            if (idx < 0) idx += 26;
-            out[out_i] = (char)('A' + idx);
-        } else if (c >= 'a' && c <= 'z') { // lowercase letter decoding 
-            int idx = c - 'a';
-            idx = (idx - shift) % 26;
-            if (idx < 0) idx += 26;
-            out[out_i] = (char)('a' + idx) 
-        } else {
-            out[out_i] = c;
-        }
-    }
-
-    out[out_i] = '\0'; // null terminate the decode 
-}
-
-static void wizard_handler(int sig) {
-    if (!g_dungeon) return; //safety
-
-    if (sig == WIZARD_SIGNAL) {
-        decode_barrier();
-    } else if (sig == SEMAPHORE_SIGNAL) {
-    }
-}
-
 int main(void){
-    int fd = shm_open(dungeon_shm_name, O_RDWR, 0660);
-    if (fd == -1) {
-        perror("wizard shm_open"); // print why it failed 
+    dungeon_rt_apply("Wizard", ROLE_WIZARD); // only with DUNGEON_RT set 
+
+    g_dungeon = dungeon_attach("wizard"); // inherited fd from the game, or shm_open() 
+    if (!g_dungeon) {
         return EXIT_FAILURE; // exit with failure code 
     }
-
-    g_dungeon = mmap(NULL, sizeof(struct Dungeon),
-                     PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0); // we need to write/read, shared with other processes 
-    if (g_dungeon == MAP_FAILED) {
-        perror("wizard mmap");
-        close(fd);
-        return EXIT_FAILURE;
+    if (!dungeon_standby_wait(g_dungeon, ROLE_WIZARD)) { // a hot standby that was never promoted 
+        munmap(g_dungeon, sizeof(struct Dungeon));
+        return EXIT_SUCCESS;
     }
-    close(fd); // no need to fix 
-
-    struct sigaction sa;
-    sa.sa_handler = wizard_handler;  // to handle signlas 
-    sigemptyset(&sa.sa_mask); // no signal blocked during handler 
-    sa.sa_flags = 0; // default behaviour
 
-    if (sigaction(WIZARD_SIGNAL, &sa, NULL) == -1) {
-        perror("wizard sigaction WIZARD_SIGNAL");
+    // signals are read from a signalfd, so the decode never runs in signal context 
+    struct RoleRuntime rt;
+    if (role_runtime_open(&rt, g_dungeon, ROLE_WIZARD) == -1) {
+        perror("wizard role runtime");
         return EXIT_FAILURE;
     }
-    if (sigaction(SEMAPHORE_SIGNAL, &sa, NULL) == -1) {
-        perror("wizard sigaction SEMAPORE_SIGNAL");
-        return EXIT_FAILURE;
+    dungeon_mark_ready(g_dungeon, ROLE_WIZARD);
+
+    struct RoleContext ctx;
+    role_context_init(&ctx, g_dungeon, ROLE_WIZARD);
+    ctx.stats = rt.stats; // live metrics for dungeonstat, NULL without the stats extension 
+    ctx.trace = rt.trace; // event ring, NULL unless DUNGEON_TRACE is set 
+    static struct SpellCache cache; // bounded, see spell_cache.h 
+    wizard_use_spell_cache(&ctx, &cache);
+    static struct SpellWorkers workers; // threads for large spells 
+    struct SpellArena *arena = spell_arena_open(); // only in large-spell mode 
+    if (arena) {
+        wizard_use_spell_arena(&ctx, arena, &workers);
     }
 
-    while (g_dungeon->running) {
-        pause(); // sleep until any signal arrive 
+    while (dungeon_running(g_dungeon)) {
+        uint32_t bits = role_runtime_wait(&rt, -1); // sleep until a signal or the doorbell 
+        if (bits & DOORBELL_SHUTDOWN) {
+            break;
+        }
+        if (bits & DOORBELL_ENCOUNTER) {
+            wizard_decode_barrier(&ctx);
+            role_runtime_done(&rt);
+        }
+        if (bits & DOORBELL_QUEUE) { // queued barriers, answered in batches 
+            if (!ctx.queues) ctx.queues = dungeon_queues_open(); 
+            role_drain_queue(&ctx);
+            role_runtime_done(&rt);
+        }
     }
+    role_runtime_report(&rt, "Wizard");
+    wizard_spell_cache_report(&ctx);
+    wizard_spell_arena_close(&ctx);
+    spell_arena_close(arena);
+    dungeon_queues_close(ctx.queues);
+    role_runtime_close(&rt);
 
     munmap(g_dungeon, sizeof(struct Dungeon)); //unmap shared memory
     return EXIT_SUCCESS; // exit 